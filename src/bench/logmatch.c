@@ -0,0 +1,237 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// logmatch.c
+// microbenchmark of the log checks: the literal search of the patterns
+// without regex metacharacters against the PCRE2 path
+//
+// the log lines are read from a file, eg. the captured log of a CRS run
+// (one line per log message), and every pattern is checked against the
+// whole log as a stage check does it: the search stops at the first line
+// which contains the pattern
+//
+// usage: logmatch [-n iterations] logfile [pattern...]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+#include "../ftwtestutils.h"
+
+#define LOGMATCH_ITERATIONS 1000
+
+// the patterns of the CRS tests, if no pattern is given
+static const char * default_patterns[] = {
+    "id \"942100\"",
+    "id \"949110\"",
+    "\\[msg \"Inbound Anomaly Score Exceeded",
+    "id \"9421[0-9]{2}\"",
+    NULL
+};
+
+typedef struct logmatch_log_t {
+    char        ** lines;
+    size_t       * lens;
+    unsigned int   count;
+} logmatch_log;
+
+// read the log lines of a file, the line ends are removed
+static int read_log(const char * path, logmatch_log * log) {
+    FILE   * fp       = fopen(path, "r");
+    char   * line     = NULL;
+    size_t   linesize = 0;
+    ssize_t  len;
+
+    if (fp == NULL) {
+        return -1;
+    }
+    while ((len = getline(&line, &linesize, fp)) != -1) {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) {
+            line[--len] = '\0';
+        }
+        char  ** lines = realloc(log->lines, sizeof(char *) * (log->count + 1));
+        size_t * lens  = realloc(log->lens, sizeof(size_t) * (log->count + 1));
+        if (lines != NULL) {
+            log->lines = lines;
+        }
+        if (lens != NULL) {
+            log->lens = lens;
+        }
+        if (lines == NULL || lens == NULL || (log->lines[log->count] = strdup(line)) == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        log->lens[log->count++] = len;
+    }
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+// the literal path: find_literal() on every line until the first hit
+static unsigned long long check_literal(const logmatch_log * log, const char * literal, unsigned int * hits) {
+    size_t             literal_len = strlen(literal);
+    unsigned long long start       = monotonic_ns();
+
+    for (unsigned int i = 0; i < log->count; i++) {
+        if (find_literal(log->lines[i], log->lens[i], literal, literal_len) != NULL) {
+            (*hits)++;
+            break;
+        }
+    }
+    return monotonic_ns() - start;
+}
+
+// match a compiled pattern on every line until the first hit
+static void match_lines(const logmatch_log * log, pcre2_code * re, pcre2_match_data * match_data, unsigned int * hits) {
+    for (unsigned int i = 0; i < log->count; i++) {
+        if (pcre2_match(re, (PCRE2_SPTR)log->lines[i], log->lens[i], 0, 0, match_data, NULL) > 0) {
+            (*hits)++;
+            break;
+        }
+    }
+}
+
+// compile a pattern with JIT
+static pcre2_code * compile_pattern(const char * pattern) {
+    int          errornumber;
+    PCRE2_SIZE   erroroffset;
+    pcre2_code * re = pcre2_compile((PCRE2_SPTR)pattern, PCRE2_ZERO_TERMINATED, 0, &errornumber, &erroroffset, NULL);
+
+    if (re != NULL) {
+        pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
+    }
+    return re;
+}
+
+// the PCRE2 path of logContains(): the pattern is compiled for every check
+static unsigned long long check_pcre2(const logmatch_log * log, const char * pattern, unsigned int * hits) {
+    unsigned long long  start = monotonic_ns();
+    pcre2_code        * re    = compile_pattern(pattern);
+    pcre2_match_data  * match_data;
+
+    if (re == NULL) {
+        return 0;
+    }
+    match_data = pcre2_match_data_create_from_pattern(re, NULL);
+    match_lines(log, re, match_data, hits);
+    pcre2_match_data_free(match_data);
+    pcre2_code_free(re);
+    return monotonic_ns() - start;
+}
+
+static void usage(const char * name) {
+    printf("Use: %s [OPTIONS] logfile [pattern...]\n", name);
+    printf("\t-n\tNumber of the checks of every pattern, default %d\n", LOGMATCH_ITERATIONS);
+    printf("\t-h\tThis help\n");
+    printf("The default patterns are the typical patterns of the CRS tests.\n");
+}
+
+int main(int argc, char ** argv) {
+    logmatch_log         log        = {NULL, NULL, 0};
+    unsigned int         iterations = LOGMATCH_ITERATIONS;
+    const char        ** patterns   = default_patterns;
+    int                  c;
+
+    while ((c = getopt(argc, argv, "n:h")) != -1) {
+        switch (c) {
+            case 'n':
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Error: invalid number of the checks '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                iterations = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (read_log(argv[optind], &log) != 0) {
+        fprintf(stderr, "Error: can't read the log file %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if (optind + 1 < argc) {
+        patterns = (const char **)&argv[optind + 1];
+    }
+
+    printf("LOG LINES:              %u\n", log.count);
+    printf("CHECKS PER PATTERN:     %u\n", iterations);
+    printf("===============================\n");
+    printf("%-40s %10s %10s %10s %8s\n", "PATTERN (ns/check)", "literal", "pcre2", "match", "speedup");
+    for (int p = 0; patterns[p] != NULL; p++) {
+        char                * literal       = literal_pattern(patterns[p]);
+        pcre2_code          * re            = compile_pattern(patterns[p]);
+        pcre2_match_data    * match_data    = (re != NULL) ? pcre2_match_data_create_from_pattern(re, NULL) : NULL;
+        unsigned long long    literal_ns    = 0;
+        unsigned long long    pcre2_ns      = 0;
+        unsigned long long    match_ns      = 0;
+        unsigned int          literal_hits  = 0;
+        unsigned int          pcre2_hits    = 0;
+        unsigned int          match_hits    = 0;
+
+        if (re == NULL) {
+            fprintf(stderr, "Error: invalid pattern '%s'\n", patterns[p]);
+            free(literal);
+            continue;
+        }
+        for (unsigned int i = 0; i < iterations; i++) {
+            unsigned long long start;
+            if (literal != NULL) {
+                literal_ns += check_literal(&log, literal, &literal_hits);
+            }
+            pcre2_ns += check_pcre2(&log, patterns[p], &pcre2_hits);
+            start     = monotonic_ns();
+            match_lines(&log, re, match_data, &match_hits);
+            match_ns += monotonic_ns() - start;
+        }
+        if (literal != NULL && literal_hits != pcre2_hits) {
+            fprintf(stderr, "Error: the literal and the PCRE2 checks of '%s' differ\n", patterns[p]);
+        }
+        if (literal != NULL) {
+            printf("%-40.40s %10.1f %10.1f %10.1f %7.1fx\n", patterns[p], (double)literal_ns / iterations,
+                   (double)pcre2_ns / iterations, (double)match_ns / iterations,
+                   (literal_ns > 0) ? (double)pcre2_ns / literal_ns : 0.0);
+        }
+        else {
+            printf("%-40.40s %10s %10.1f %10.1f %8s\n", patterns[p], "-", (double)pcre2_ns / iterations,
+                   (double)match_ns / iterations, "-");
+        }
+        pcre2_match_data_free(match_data);
+        pcre2_code_free(re);
+        free(literal);
+    }
+    printf("===============================\n");
+    printf("literal: find_literal(), pcre2: compile, JIT and match as logContains(), match: only the match\n");
+
+    for (unsigned int i = 0; i < log.count; i++) {
+        free(log.lines[i]);
+    }
+    free(log.lines);
+    free(log.lens);
+    return EXIT_SUCCESS;
+}
@@ -39,6 +39,13 @@
 #include "ftwcoraza/ftwcoraza.h"
 #include "ftwmodsecurity/ftwmodsecurity.h"
 #include "ftwdummy/ftwdummy.h"
+#include "../ftwtestutils.h"
+#include "../ftwprobes.h"
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 
 char **loglines = NULL;
@@ -46,6 +53,182 @@ static int loglines_count = 0;
 static int loglines_count_allocated = 0;
 static pthread_mutex_t lock;
 
+// the messages of a stage child to the runner, see engine_run_stage()
+#define STAGE_MSG_PHASE  1
+#define STAGE_MSG_LOG    2
+#define STAGE_MSG_RESULT 3
+
+typedef struct engine_stage_msg_t {
+    int                  kind;
+    int                  value;     // the phase, the length of the log line, or the result
+    unsigned long long   ns;        // the time of the phase
+    ftw_alloc_counters   alloc;     // the allocations of the phase
+} engine_stage_msg;
+
+// the write end of the pipe in a stage child, -1 in the runner
+static int stage_pipe = -1;
+
+// send a message of a stage child to the runner
+// the child exits if the runner is gone
+static void stage_write(const void * data, size_t len) {
+    const char * p = data;
+
+    while (len > 0) {
+        ssize_t n = write(stage_pipe, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            _exit(EXIT_FAILURE);
+        }
+        p   += n;
+        len -= n;
+    }
+}
+
+// read a message of the stage child until the deadline, 0 means no deadline
+// returns 1 if the message is read, 0 at the end of the child, -1 if the
+// deadline passed
+static int stage_read(int fd, void * data, size_t len, unsigned long long deadline) {
+    char * p = data;
+
+    while (len > 0) {
+        ssize_t n;
+        if (deadline > 0) {
+            unsigned long long now = monotonic_ns();
+            struct pollfd      pfd = {fd, POLLIN, 0};
+            if (now >= deadline) {
+                return -1;
+            }
+            if (poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000)) <= 0) {
+                continue;
+            }
+        }
+        n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p   += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/*
+ * Stored logs of the requests
+ */
+
+#define FTW_DEDUP_MINSIZE 1024
+
+// create an empty table
+ftw_dedup * ftw_dedup_new() {
+    ftw_dedup * dedup = calloc(1, sizeof(ftw_dedup));
+    if (dedup == NULL) {
+        return NULL;
+    }
+    dedup->entries = calloc(FTW_DEDUP_MINSIZE, sizeof(ftw_dedup_entry));
+    if (dedup->entries == NULL) {
+        free(dedup);
+        return NULL;
+    }
+    dedup->size = FTW_DEDUP_MINSIZE;
+    return dedup;
+}
+
+// free the table and the stored logs
+void ftw_dedup_free(ftw_dedup * dedup) {
+    if (dedup != NULL) {
+        for (unsigned int i = 0; i < dedup->size; i++) {
+            for (unsigned int l = 0; l < dedup->entries[i].lines_count; l++) {
+                free(dedup->entries[i].lines[l]);
+            }
+            free(dedup->entries[i].lines);
+            free(dedup->entries[i].request);
+        }
+        free(dedup->entries);
+        free(dedup);
+    }
+}
+
+// a pruned request runs less phases, the flag ends its serialized request
+static unsigned char * ftw_dedup_request_mark(unsigned char * request, size_t * len, int skip_response_phases) {
+    unsigned char * marked = realloc(request, *len + 1);
+    if (marked == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    marked[(*len)++] = (unsigned char)skip_response_phases;
+    return marked;
+}
+
+// same request: the hash only finds the slot, the whole request is compared
+static int ftw_dedup_match(const ftw_dedup_entry * entry, unsigned long long key, const unsigned char * request, size_t request_len) {
+    return entry->key == key && entry->request_len == request_len
+        && (request_len == 0 || memcmp(entry->request, request, request_len) == 0);
+}
+
+// find the slot of a request, or the empty slot where it should be stored
+static ftw_dedup_entry * ftw_dedup_slot(const ftw_dedup * dedup, unsigned long long key, const unsigned char * request, size_t request_len) {
+    unsigned int i = (unsigned int)(key & (dedup->size - 1));
+
+    while (dedup->entries[i].used == 1 && ftw_dedup_match(&dedup->entries[i], key, request, request_len) == 0) {
+        i = (i + 1) & (dedup->size - 1);
+    }
+    return &dedup->entries[i];
+}
+
+// find the stored log of a request
+ftw_dedup_entry * ftw_dedup_lookup(const ftw_dedup * dedup, unsigned long long key, const unsigned char * request, size_t request_len) {
+    ftw_dedup_entry * entry = ftw_dedup_slot(dedup, key, request, request_len);
+    return (entry->used == 1) ? entry : NULL;
+}
+
+// store a copy of the request and of its log
+void ftw_dedup_store(ftw_dedup * dedup, unsigned long long key, const unsigned char * request, size_t request_len, const char ** lines, unsigned int lines_count) {
+    ftw_dedup_entry * entry;
+
+    if ((dedup->count + 1) * 2 > dedup->size) {
+        // keep the load factor under 0.5
+        ftw_dedup_entry * old      = dedup->entries;
+        unsigned int      old_size = dedup->size;
+
+        dedup->entries = calloc(old_size * 2, sizeof(ftw_dedup_entry));
+        if (dedup->entries == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        dedup->size = old_size * 2;
+        for (unsigned int i = 0; i < old_size; i++) {
+            if (old[i].used == 1) {
+                *ftw_dedup_slot(dedup, old[i].key, old[i].request, old[i].request_len) = old[i];
+            }
+        }
+        free(old);
+    }
+    entry = ftw_dedup_slot(dedup, key, request, request_len);
+    if (entry->used == 1) {
+        return;
+    }
+    entry->lines   = calloc(lines_count + 1, sizeof(char *));
+    entry->request = malloc(request_len + 1);
+    if (entry->lines == NULL || entry->request == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int i = 0; i < lines_count; i++) {
+        entry->lines[i] = strdup(lines[i]);
+    }
+    memcpy(entry->request, request, request_len);
+    entry->request_len = request_len;
+    entry->lines_count = lines_count;
+    entry->key         = key;
+    entry->used        = 1;
+    dedup->count++;
+}
+
 /*
  * Logger
  */
@@ -64,6 +247,58 @@ void logCbClearLog() {
     loglines_count = 0;
 }
 
+// collect the ids of the fired rules ('[id "N"]') from the log
+static void logCbFiredIds(ftw_engine * engine) {
+    engine->fired_ids_count = 0;
+    if (engine->fired == NULL) {
+        return;
+    }
+    for (int i = 0; i < loglines_count; i++) {
+        const char * p = loglines[i];
+        while ((p = strstr(p, "[id \"")) != NULL) {
+            unsigned int id = strtoul(p + 5, NULL, 10);
+            p += 5;
+            if (id == 0) {
+                continue;
+            }
+            unsigned int * tmp = realloc(engine->fired_ids, sizeof(unsigned int) * (engine->fired_ids_count + 1));
+            if (tmp == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            engine->fired_ids = tmp;
+            engine->fired_ids[engine->fired_ids_count++] = id;
+        }
+    }
+}
+
+// the engines call it at the end of a stage, before they clear the log
+// the fired rules are collected, and the log is stored for the identical
+// requests
+void logCbStageDone(ftw_engine * engine) {
+    if (stage_pipe >= 0) {
+        // a stage child sends its log, the runner collects the fired rules
+        for (int i = 0; i < loglines_count; i++) {
+            engine_stage_msg msg = {STAGE_MSG_LOG, (int)strlen(loglines[i]), 0, {0}};
+            stage_write(&msg, sizeof(msg));
+            stage_write(loglines[i], msg.value);
+        }
+        return;
+    }
+    logCbFiredIds(engine);
+    if (engine->dedup != NULL) {
+        ftw_dedup_store(engine->dedup, engine->dedup_key, engine->dedup_request, engine->dedup_request_len, (const char **)loglines, loglines_count);
+    }
+}
+
+// load a stored log as the log of the current stage
+static void logCbLoad(char ** lines, unsigned int lines_count) {
+    logCbClearLog();
+    for (unsigned int i = 0; i < lines_count; i++) {
+        logCbText(NULL, lines[i]);
+    }
+}
+
 // cleanup the whole log structure
 void logCbCleanup() {
     if (loglines != NULL) {
@@ -71,7 +306,10 @@ void logCbCleanup() {
             free(loglines[i]);
         }
         free(loglines);
+        loglines = NULL;
     }
+    loglines_count           = 0;
+    loglines_count_allocated = 0;
 }
 
 // add a line to the log
@@ -120,14 +358,43 @@ void logCbDump() {
     }
 }
 
+// search a literal in the log lines
+// used by logContains() if the pattern has no any regex metacharacter
+static char * logContainsLiteral(const char * literal, const char * format, const char * format_reset) {
+    size_t literal_len = strlen(literal);
+
+    for (int i = 0; i < loglines_count; i++) {
+        size_t subject_len = strlen(loglines[i]);
+        const char * found = find_literal(loglines[i], subject_len, literal, literal_len);
+        if (found != NULL) {
+            size_t offset = found - loglines[i];
+            char * tstr   = calloc(1, subject_len + strlen(format) + strlen(format_reset) + 1);
+            if (tstr == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            // colorized substring
+            strncat(tstr, loglines[i], offset);
+            strcat(tstr, format);
+            strncat(tstr, found, literal_len);
+            strcat(tstr, format_reset);
+            strcat(tstr, found + literal_len);
+            return tstr;
+        }
+    }
+    return NULL;
+}
+
 // search a patternin a log line
+// literal is the metacharacter-free form of the pattern (see literal_pattern()),
+// if it's not NULL, the pattern is matched without PCRE2
 // negate reverse the result and colorize with red the result
 // elsewhise colorize with green
-char * logContains(char * pattern, int negate) {
+char * logContains(char * pattern, const char * literal, int negate) {
 
     pcre2_code          * re           = NULL;
     pcre2_match_data    * match_data;
-    pcre2_match_context * mcontext;
+    pcre2_match_context * mcontext     = NULL;
     pcre2_jit_stack     * jit_stack    = NULL;
     int                   errornumber;
     PCRE2_SIZE            erroroffset;
@@ -141,6 +408,10 @@ char * logContains(char * pattern, int negate) {
 
     const char  * format = (negate) ? format_bred : format_bgreen;
 
+    if (literal != NULL) {
+        return logContainsLiteral(literal, format, format_reset);
+    }
+
     re = pcre2_compile(
         (unsigned char*)pattern,
         PCRE2_ZERO_TERMINATED, //PCRE2_DOTALL | PCRE2_DOLLAR_ENDONLY,
@@ -259,13 +530,90 @@ char * logContains(char * pattern, int negate) {
     return tstr;
 }
 
+// check the log of a stage against its expected output
+int ftw_engine_check_log(const ftw_stage * stage, int debug) {
+    int ret = FTW_TEST_FAIL;
+
+    FTW_PROBE(assertion_start);
+
+    char * log = NULL;
+    if (stage->output->log_contains != NULL) {
+        log = logContains(stage->output->log_contains, stage->output->log_contains_literal, 0);
+        if (log != NULL) {
+            ret = FTW_TEST_PASS;
+            if (debug == 1) {
+                printf("%s\n", log);
+            }
+            free(log);
+        }
+        else {
+            ret = FTW_TEST_FAIL;
+            if (debug == 1) {
+                printf("Log no contains required pattern: '%s'\n", stage->output->log_contains);
+            }
+        }
+    }
+    if (stage->output->no_log_contains != NULL) {
+        log = logContains(stage->output->no_log_contains, stage->output->no_log_contains_literal, 1);
+        if (log == NULL) {
+            ret = FTW_TEST_PASS;
+        }
+        else {
+            ret = FTW_TEST_FAIL;
+            if (debug == 1) {
+                printf("%s\n", log);
+            }
+            free(log);
+        }
+    }
+    if (stage->output->log != NULL && stage->output->log->expect_ids_len > 0) {
+        for(int i = 0; i < stage->output->log->expect_ids_len; i++) {
+            char idsubj[50];
+            sprintf(idsubj, "id \"%u\"", stage->output->log->expect_ids[i]);
+            log = logContains(idsubj, idsubj, 0);
+            if (log != NULL) {
+                ret = FTW_TEST_PASS;
+                if (debug == 1) {
+                    printf("%s\n", log);
+                }
+                free(log);
+            }
+            else {
+                ret = FTW_TEST_FAIL;
+                if (debug == 1) {
+                    printf("Log no contains required pattern: '%s'\n", idsubj);
+                }
+            }
+        }
+    }
+    if (stage->output->log != NULL && stage->output->log->no_expect_ids_len > 0) {
+        for(int i = 0; i < stage->output->log->no_expect_ids_len; i++) {
+            char idsubj[50];
+            sprintf(idsubj, "id \"%u\"", stage->output->log->no_expect_ids[i]);
+            log = logContains(idsubj, idsubj, 1);
+            if (log == NULL) {
+                ret = FTW_TEST_PASS;
+            }
+            else {
+                ret = FTW_TEST_FAIL;
+                if (debug == 1) {
+                    printf("%s\n", log);
+                }
+                free(log);
+            }
+        }
+    }
+
+    FTW_PROBE1(assertion_done, ret);
+    return ret;
+}
+
 /*
  * End Logger
  */
 
-// init the engine
-// this is a wrapper for the engine init function
-ftw_engine * ftw_engine_init(int enginetype, char * main_rule_uri, const char ** error) {
+// allocate an engine with empty counters
+static ftw_engine * engine_alloc(int enginetype) {
     ftw_engine * engine = malloc(sizeof(ftw_engine));
 
     if (engine == NULL) {
@@ -282,12 +630,60 @@ ftw_engine * ftw_engine_init(int enginetype, char * main_rule_uri, const char **
     engine->cnt_total    = 0;
     engine->cnt_disabled = 0;
 
+    engine->cnt_pruned   = 0;
+    engine->cnt_cached   = 0;
+    engine->cnt_deduped  = 0;
+    engine->cnt_replayed = 0;
+    engine->cnt_timeout  = 0;
+    engine->cnt_not_affected = 0;
+
+    engine->stop_on_disruptive   = 0;
+    engine->ruleindex            = NULL;
+    engine->skip_response_phases = 0;
+    engine->response_time_ns     = 0;
+    engine->response_count       = 0;
+    engine->cache                = NULL;
+    engine->fired                = NULL;
+    engine->fired_ids            = NULL;
+    engine->fired_ids_count      = 0;
+    engine->dedup                = NULL;
+    engine->dedup_key            = 0;
+    engine->dedup_request        = NULL;
+    engine->dedup_request_len    = 0;
+    engine->phase_mask           = 0;
+    engine->show_phases          = 0;
+    engine->output_ns            = 0;
+    engine->alloc_stats          = 0;
+    engine->heap_stats           = 0;
+    engine->heap_mark            = 0;
+    engine->heap_growth          = 0;
+    engine->quiet                = 0;
+    engine->perf                 = NULL;
+    engine->timeout_ns           = 0;
+    engine->timeout_phase        = -1;
+    engine->timeout_test_list    = NULL;
+    memset(engine->phase_alloc, 0, sizeof(engine->phase_alloc));
+    memset(engine->phase_alloc_total, 0, sizeof(engine->phase_alloc_total));
+    memset(engine->phase_hist, 0, sizeof(engine->phase_hist));
+
     logCbInit();
 
     engine->failed_test_list = malloc(sizeof(char*));
     engine->failed_wl_test_list = malloc(sizeof(char*));
     engine->passed_wl_test_list = malloc(sizeof(char*));
 
+    engine->engine_instance = NULL;
+    engine->rules           = NULL;
+
+    return engine;
+}
+
+// init the engine
+// this is a wrapper for the engine init function
+ftw_engine * ftw_engine_init(int enginetype, char * main_rule_uri, const char ** error) {
+    ftw_engine * engine = engine_alloc(enginetype);
+
+    FTW_PROBE1(rules_load_start, main_rule_uri);
     switch(enginetype) {
         case FTW_ENGINE_TYPE_DUMMY:
             engine->engine_instance = (void*)1;
@@ -312,6 +708,30 @@ ftw_engine * ftw_engine_init(int enginetype, char * main_rule_uri, const char **
 #endif
 
     }
+    FTW_PROBE2(rules_load_done, main_rule_uri, (*error != NULL) ? 1 : 0);
+    return engine;
+}
+
+// initialize the engine and load the rules from groups of rule files
+// (see ftw_ruleindex_write()), which are merged in the given order
+ftw_engine * ftw_engine_init_groups(int enginetype, char ** rule_uris, int group_count, const char ** error) {
+    ftw_engine * engine = engine_alloc(enginetype);
+
+    FTW_PROBE1(rules_load_start, rule_uris[0]);
+    switch(enginetype) {
+#ifdef HAVE_MODSECURITY
+        case FTW_ENGINE_TYPE_MODSECURITY:
+            engine->engine_instance = (void*)ftw_engine_init_msc();
+            engine->rules           = (void*)ftw_engine_create_rules_set_groups_msc(engine->engine_instance, rule_uris, group_count, error);
+            engine->runtest         = ftw_engine_runtest_msc;
+            break;
+#endif
+
+        default:
+            *error = "rule groups are supported only by the modsecurity engine";
+            break;
+    }
+    FTW_PROBE2(rules_load_done, rule_uris[0], (*error != NULL) ? 1 : 0);
     return engine;
 }
 
@@ -337,6 +757,14 @@ void ftw_engine_free(ftw_engine * engine) {
             }
             free(engine->passed_wl_test_list);
         }
+        for (int i = 0; i < engine->cnt_timeout; i++) {
+            free(engine->timeout_test_list[i]);
+        }
+        free(engine->timeout_test_list);
+        ftw_ruleindex_free(engine->ruleindex);
+        free(engine->fired_ids);
+        ftw_dedup_free(engine->dedup);
+        free(engine->dedup_request);
 
         switch(engine->engine_type) {
             case FTW_ENGINE_TYPE_DUMMY:
@@ -373,6 +801,66 @@ void ftw_engine_free(ftw_engine * engine) {
     logCbCleanup();
 }
 
+// reset the results of the engine, eg. between the runs of the daemon
+void ftw_engine_reset(ftw_engine * engine) {
+    for (int i = 0; i < engine->cnt_failed; i++) {
+        free(engine->failed_test_list[i]);
+    }
+    for (int i = 0; i < engine->cnt_failedwl; i++) {
+        free(engine->failed_wl_test_list[i]);
+    }
+    for (int i = 0; i < engine->cnt_passedwl; i++) {
+        free(engine->passed_wl_test_list[i]);
+    }
+    for (int i = 0; i < engine->cnt_timeout; i++) {
+        free(engine->timeout_test_list[i]);
+    }
+    engine->cnt_passed       = 0;
+    engine->cnt_passedwl     = 0;
+    engine->cnt_failed       = 0;
+    engine->cnt_failedwl     = 0;
+    engine->cnt_skipped      = 0;
+    engine->cnt_total        = 0;
+    engine->cnt_disabled     = 0;
+    engine->cnt_pruned       = 0;
+    engine->cnt_cached       = 0;
+    engine->cnt_deduped      = 0;
+    engine->cnt_replayed     = 0;
+    engine->cnt_timeout      = 0;
+    engine->cnt_not_affected = 0;
+    engine->response_time_ns = 0;
+    engine->response_count   = 0;
+    memset(engine->phase_hist, 0, sizeof(engine->phase_hist));
+    engine->output_ns        = 0;
+    memset(engine->phase_alloc_total, 0, sizeof(engine->phase_alloc_total));
+}
+
+// name and version of the engine
+const char * ftw_engine_version(const ftw_engine * engine) {
+    switch(engine->engine_type) {
+#ifdef HAVE_MODSECURITY
+        case FTW_ENGINE_TYPE_MODSECURITY:
+            return msc_who_am_i((ModSecurity *)engine->engine_instance);
+#endif
+#ifdef HAVE_LIBCORAZA
+        case FTW_ENGINE_TYPE_CORAZA:
+            // libcoraza has no version API
+            return "Coraza";
+#endif
+    }
+    return "Dummy";
+}
+
+static const char * phase_names[FTW_PHASE_COUNT] = {
+    "connection", "uri", "request headers", "request body",
+    "response headers", "response body", "logging", "log check"
+};
+
+// name of a timed phase
+const char * ftw_engine_phase_name(int phase) {
+    return phase_names[phase];
+}
+
 // show the cummulated test results
 void ftw_engine_show_result(const ftw_engine * engine) {
     printf("\n");
@@ -390,9 +878,57 @@ void ftw_engine_show_result(const ftw_engine * engine) {
     printf("FAILED (whitelisted):   %d\n", engine->cnt_failedwl);
     printf("SKIPPED:                %d\n", engine->cnt_skipped);
     printf("DISABLED:               %d\n", engine->cnt_disabled);
+    if (engine->timeout_ns > 0 || engine->cnt_timeout > 0) {
+        printf("TIMEOUT:                %d\n", engine->cnt_timeout);
+    }
     printf("===============================\n");
     printf("TOTAL:                  %d\n", engine->cnt_total);
     printf("===============================\n");
+    if (engine->cache != NULL) {
+        printf("REUSED FROM CACHE:      %d\n", engine->cnt_cached);
+        printf("===============================\n");
+    }
+    if (engine->cnt_replayed > 0) {
+        printf("FROM JOURNAL:           %d\n", engine->cnt_replayed);
+        printf("===============================\n");
+    }
+    if (engine->dedup != NULL) {
+        printf("IDENTICAL REQUESTS:     %d (sent once)\n", engine->cnt_deduped);
+        printf("===============================\n");
+    }
+    if (engine->cnt_pruned > 0) {
+        // estimated by the average time of the response phases of the other
+        // stages, a pruned stage stopped before the phase 3 (see '-b') saved
+        // nothing, so the estimate is an upper bound
+        if (engine->response_count > 0) {
+            double saved_ms = (double)engine->response_time_ns / engine->response_count * engine->cnt_pruned / 1000000.0;
+            printf("PRUNED RESPONSE PHASES: %d (~%.2f ms saved, at the average of %d stages with response phases)\n", engine->cnt_pruned, saved_ms, engine->response_count);
+        }
+        else {
+            // every stage was pruned, there is no sample of the response phases
+            printf("PRUNED RESPONSE PHASES: %d (saved time unknown, no response phase was run)\n", engine->cnt_pruned);
+        }
+        printf("===============================\n");
+    }
+    if (engine->show_phases == 1) {
+        printf("PHASE TIMES (us)        count       mean        p50        p90        p99        max\n");
+        for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+            const ftw_histogram * h = &engine->phase_hist[p];
+            printf("%-20s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", phase_names[p], h->count,
+                (h->count > 0) ? (double)h->sum / h->count / 1000.0 : 0.0,
+                ftw_histogram_percentile(h, 50) / 1000.0, ftw_histogram_percentile(h, 90) / 1000.0,
+                ftw_histogram_percentile(h, 99) / 1000.0, h->max / 1000.0);
+        }
+        printf("===============================\n");
+    }
+    if (engine->alloc_stats == 1) {
+        printf("PHASE ALLOCATIONS           allocs      frees        bytes\n");
+        for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+            const ftw_alloc_counters * c = &engine->phase_alloc_total[p];
+            printf("%-23s %10llu %10llu %12llu\n", phase_names[p], c->allocs, c->frees, c->bytes);
+        }
+        printf("===============================\n");
+    }
     if (engine->cnt_failed > 0) {
         printf("FAILED TESTS:\n");
         for (int i = 0; i < engine->cnt_failed; i++) {
@@ -413,6 +949,13 @@ void ftw_engine_show_result(const ftw_engine * engine) {
         }
         printf("\n===============================\n");
     }
+    if (engine->cnt_timeout > 0) {
+        printf("TIMED OUT TESTS:\n");
+        for (int i = 0; i < engine->cnt_timeout; i++) {
+            printf("%s\n", engine->timeout_test_list[i]);
+        }
+        printf("===============================\n");
+    }
     if (engine->cnt_passedwl > 0) {
         printf("PASSED WHITELISTED TESTS:\n");
         for (int i = 0; i < engine->cnt_passedwl; i++) {
@@ -451,6 +994,9 @@ static void fancy_print(const char * test_title, int code, const char * msg, int
         case FTW_TEST_SKIP:
             printf("\033[94mSKIPPED\033[0m");
             break;
+        case FTW_TEST_TIMEOUT:
+            printf("\033[95mTIMEOUT\033[0m");
+            break;
     }
     if (strlen(msg) > 0) {
         printf(" %s", msg);
@@ -478,73 +1024,366 @@ int qsearch(char **array, int size, const char *key) {
     return -1;
 }
 
-// run a test with an engine
-int engine_runtest(ftw_engine * engine, int enabled, int listed, char * title, ftw_stage *stage, int debug, int verbose) {
+// check an id against the rule index
+// returns 1 if the rule is declared and runs in a request phase
+static int rule_is_request_phase(const ftw_engine * engine, unsigned int id) {
+    const ftw_rule * rule = ftw_ruleindex_find(engine->ruleindex, id);
+    return (rule != NULL && rule->phase >= 1 && rule->phase <= 2) ? 1 : 0;
+}
+
+// check a log pattern: it can be pruned if it's an 'id "N"' literal
+// and rule N runs in a request phase
+static int pattern_is_request_phase(const ftw_engine * engine, const char * literal) {
+    unsigned int id;
+    int          n = 0;
+
+    if (literal == NULL || sscanf(literal, "id \"%u\"%n", &id, &n) != 1 || n == 0 || literal[n] != '\0') {
+        return 0;
+    }
+    return rule_is_request_phase(engine, id);
+}
 
-    const ftw_input  * input  = stage->input;
+// decide whether the response phases (3 and 4) can be skipped:
+// all of the expected and unexpected rules must run in phase 1 or 2
+static int stage_needs_response(const ftw_engine * engine, const ftw_stage * stage) {
     const ftw_output * output = stage->output;
+    int                ids    = 0;
 
-    if (enabled == 0) {
-        fancy_print(title, FTW_TEST_DISA, "", 0);
-        engine->cnt_disabled++;
+    if (engine->ruleindex == NULL) {
+        return 1;
     }
-    else {
-        if (input->encoded_request != NULL && strlen(input->encoded_request) > 0) {
-            fancy_print(title, FTW_TEST_SKIP, "'encoded_request' not implemented yet", listed);
-            engine->cnt_skipped++;
+    if (output->log_contains != NULL) {
+        if (pattern_is_request_phase(engine, output->log_contains_literal) == 0) {
+            return 1;
         }
-        else if (input->raw_request != NULL && (input->raw_request) > 0) {
-            fancy_print(title, FTW_TEST_SKIP, "'raw_request' not implemented yet", listed);
-            engine->cnt_skipped++;
+        ids++;
+    }
+    if (output->no_log_contains != NULL) {
+        if (pattern_is_request_phase(engine, output->no_log_contains_literal) == 0) {
+            return 1;
         }
-        else if (output->expect_error != 0) {
-            fancy_print(title, FTW_TEST_SKIP, "'expect_error' is HTTP server specific - test skipped", listed);
-            engine->cnt_skipped++;
+        ids++;
+    }
+    if (output->log != NULL) {
+        for (int i = 0; i < output->log->expect_ids_len; i++, ids++) {
+            if (rule_is_request_phase(engine, output->log->expect_ids[i]) == 0) {
+                return 1;
+            }
         }
-        else if (output->status != 0) {
-            fancy_print(title, FTW_TEST_SKIP, "'status' is HTTP server specific - test skipped", listed);
-            engine->cnt_skipped++;
+        for (int i = 0; i < output->log->no_expect_ids_len; i++, ids++) {
+            if (rule_is_request_phase(engine, output->log->no_expect_ids[i]) == 0) {
+                return 1;
+            }
         }
-        else if (input->version != NULL &&
-                (strlen(input->version) == 0 ||
-                strncmp(input->version, "HTTP", 4) != 0)) {
-            fancy_print(title, FTW_TEST_SKIP, "Only HTTP protocol allowed", listed);
-            engine->cnt_skipped++;
+    }
+    return (ids == 0) ? 1 : 0;
+}
+
+// count a PASSED or FAILED result, and add the test to the lists
+static void engine_count_result(ftw_engine * engine, int listed, const char * title, int res) {
+    if (res == FTW_TEST_PASS) {
+        engine->cnt_passed++;
+        if (listed == 1) {
+            engine->cnt_passedwl++;
+            engine->passed_wl_test_list = realloc(engine->passed_wl_test_list, sizeof(char *) * engine->cnt_passedwl);
+            engine->passed_wl_test_list[engine->cnt_passedwl - 1] = strdup(title);
+        }
+    }
+    else if (res == FTW_TEST_FAIL && listed == 0) {
+        engine->failed_test_list = realloc(engine->failed_test_list, sizeof(char *) * (engine->cnt_failed + 1));
+        engine->failed_test_list[engine->cnt_failed] = strdup(title);
+        engine->cnt_failed++;
+    }
+    else if (res == FTW_TEST_FAIL && listed == 1) {
+        engine->failed_wl_test_list = realloc(engine->failed_wl_test_list, sizeof(char *) * (engine->cnt_failedwl + 1));
+        engine->failed_wl_test_list[engine->cnt_failedwl] = strdup(title);
+        engine->cnt_failedwl++;
+    }
+    else if (res == FTW_TEST_TIMEOUT) {
+        char entry[100];
+        // the phase isn't known for the results of the journal
+        if (engine->timeout_phase >= 0) {
+            snprintf(entry, sizeof(entry), "%s (%s)", title, phase_names[engine->timeout_phase]);
+        }
+        else {
+            snprintf(entry, sizeof(entry), "%s", title);
+        }
+        engine->timeout_test_list = realloc(engine->timeout_test_list, sizeof(char *) * (engine->cnt_timeout + 1));
+        engine->timeout_test_list[engine->cnt_timeout] = strdup(entry);
+        engine->cnt_timeout++;
+    }
+}
+
+// start the timing of the phases of a stage
+void ftw_engine_phase_start(ftw_engine * engine) {
+    engine->phase_mask = 0;
+    engine->phase_mark = monotonic_ns();
+    FTW_PROBE(transaction_start);
+    if (engine->perf != NULL) {
+        memset(&engine->perf_stage, 0, sizeof(ftw_perf_values));
+        ftw_perf_read(engine->perf, &engine->perf_mark);
+    }
+    if (engine->alloc_stats == 1) {
+        ftw_alloc_snapshot(&engine->alloc_mark);
+    }
+    if (engine->heap_stats == 1) {
+        engine->heap_mark = ftw_alloc_heap();
+    }
+}
+
+// a phase of the stage is done, it took the time since the previous one
+void ftw_engine_phase_done(ftw_engine * engine, int phase) {
+    unsigned long long now = monotonic_ns();
+
+    engine->phase_ns[phase] = now - engine->phase_mark;
+    engine->phase_mask     |= 1U << phase;
+    engine->phase_mark      = now;
+    FTW_PROBE2(phase_done, phase, engine->phase_ns[phase]);
+    if (engine->perf != NULL) {
+        ftw_perf_values counts;
+        ftw_perf_read(engine->perf, &counts);
+        if (phase != FTW_PHASE_CHECK) {
+            ftw_perf_add(&engine->perf_stage, &engine->perf_mark, &counts);
+        }
+        engine->perf_mark = counts;
+    }
+    if (engine->alloc_stats == 1) {
+        ftw_alloc_counters counters;
+        ftw_alloc_snapshot(&counters);
+        ftw_alloc_delta(&engine->phase_alloc[phase], &engine->alloc_mark, &counters);
+        engine->alloc_mark = counters;
+    }
+    if (stage_pipe >= 0) {
+        engine_stage_msg msg = {STAGE_MSG_PHASE, phase, engine->phase_ns[phase], engine->phase_alloc[phase]};
+        stage_write(&msg, sizeof(msg));
+    }
+}
+
+// add the phases of the last stage to the histograms
+// the transaction is freed by now, the heap growth is what it left
+static void engine_phases_done(ftw_engine * engine) {
+    if (engine->heap_stats == 1) {
+        engine->heap_growth += ftw_alloc_heap() - engine->heap_mark;
+    }
+    // the cost of the response phases, also if the stage stopped in the
+    // phase 3; the timed out stages don't reach the logging
+    if ((engine->phase_mask & (1U << FTW_PHASE_RESPONSE_HEADERS)) && (engine->phase_mask & (1U << FTW_PHASE_LOGGING))) {
+        engine->response_time_ns += engine->phase_ns[FTW_PHASE_RESPONSE_HEADERS];
+        if (engine->phase_mask & (1U << FTW_PHASE_RESPONSE_BODY)) {
+            engine->response_time_ns += engine->phase_ns[FTW_PHASE_RESPONSE_BODY];
+        }
+        engine->response_count++;
+    }
+    for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+        if (engine->phase_mask & (1U << p)) {
+            ftw_histogram_add(&engine->phase_hist[p], engine->phase_ns[p]);
+            engine->phase_alloc_total[p].allocs += engine->phase_alloc[p].allocs;
+            engine->phase_alloc_total[p].frees  += engine->phase_alloc[p].frees;
+            engine->phase_alloc_total[p].bytes  += engine->phase_alloc[p].bytes;
+        }
+    }
+}
+
+// the phase of a stopped transaction: the next one after the last done
+static int engine_stuck_phase(const ftw_engine * engine) {
+    int phase = FTW_PHASE_CONNECTION;
+
+    for (int p = FTW_PHASE_CONNECTION; p < FTW_PHASE_CHECK; p++) {
+        if (engine->phase_mask & (1U << p)) {
+            phase = p + 1;
+        }
+    }
+    if (engine->skip_response_phases == 1 && phase == FTW_PHASE_RESPONSE_HEADERS) {
+        phase = FTW_PHASE_LOGGING;
+    }
+    return phase;
+}
+
+// run the transaction of a stage
+// with a deadline the stage runs in a child process, which sends its phases,
+// its log and its result through a pipe; if the logging phase isn't done
+// until the deadline, the child is killed, and the stage is a TIMEOUT
+static int engine_run_stage(ftw_engine * engine, char * title, ftw_stage * stage, int debug, int verbose) {
+    unsigned long long deadline;
+    engine_stage_msg   msg;
+    int                fds[2];
+    int                res    = -1;
+    int                status = 0;
+    int                rc;
+    pid_t              pid;
+
+    if (engine->timeout_ns == 0) {
+        return engine->runtest(engine, title, stage, debug, verbose);
+    }
+    // the child mustn't print the buffered output again
+    fflush(stdout);
+    fflush(stderr);
+    if (pipe(fds) != 0) {
+        perror("Failed to create a pipe");
+        exit(EXIT_FAILURE);
+    }
+    if ((pid = fork()) < 0) {
+        perror("Failed to fork the stage");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        stage_pipe = fds[1];
+        res = engine->runtest(engine, title, stage, debug, verbose);
+        fflush(stdout);
+        msg = (engine_stage_msg){STAGE_MSG_RESULT, res, 0, {0}};
+        stage_write(&msg, sizeof(msg));
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+    deadline = monotonic_ns() + engine->timeout_ns;
+    while ((rc = stage_read(fds[0], &msg, sizeof(msg), deadline)) == 1) {
+        if (msg.kind == STAGE_MSG_PHASE) {
+            engine->phase_ns[msg.value]    = msg.ns;
+            engine->phase_mask            |= 1U << msg.value;
+            engine->phase_mark            += msg.ns;
+            engine->phase_alloc[msg.value] = msg.alloc;
+            if (msg.value == FTW_PHASE_LOGGING) {
+                // the check of the log isn't stopped
+                deadline = 0;
+            }
+        }
+        else if (msg.kind == STAGE_MSG_LOG) {
+            char * line = calloc(1, msg.value + 1);
+            if (line == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            if ((rc = stage_read(fds[0], line, msg.value, deadline)) == 1) {
+                logCbText(NULL, line);
+            }
+            free(line);
+            if (rc != 1) {
+                break;
+            }
+        }
+        else {
+            res = msg.value;
         }
-        else if (
-                    (output->log_contains == NULL          || strlen(output->log_contains) == 0) &&
-                    (output->no_log_contains == NULL       || strlen(output->no_log_contains) == 0) &&
-                    ((output->log->expect_ids_len == 0)    && (output->log->no_expect_ids_len == 0)) &&
-                    ((output->log->match_regex == NULL)    || (strlen(output->log->match_regex) == 0)) &&
-                    ((output->log->no_match_regex == NULL) || (strlen(output->log->no_match_regex) == 0))
-                ) {
-            fancy_print(title, FTW_TEST_SKIP, "No valid test output", listed);
+    }
+    close(fds[0]);
+    if (rc < 0) {
+        kill(pid, SIGKILL);
+    }
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+    if (rc < 0) {
+        engine->timeout_phase = engine_stuck_phase(engine);
+        // the stuck phase took the time until the stop
+        ftw_engine_phase_done(engine, engine->timeout_phase);
+        logCbClearLog();
+        return FTW_TEST_TIMEOUT;
+    }
+    if (res < 0) {
+        if (WIFSIGNALED(status)) {
+            fprintf(stderr, "Error: the transaction of %s was stopped by signal %d\n", title, WTERMSIG(status));
+        }
+        else {
+            fprintf(stderr, "Error: the transaction of %s ended without a result\n", title);
+        }
+        res = FTW_TEST_FAIL;
+    }
+    logCbStageDone(engine);
+    logCbClearLog();
+    return res;
+}
+
+// run a test with an engine
+// returns the result of the test: FTW_TEST_PASS, FTW_TEST_FAIL, FTW_TEST_SKIP or FTW_TEST_DISA
+int engine_runtest(ftw_engine * engine, int enabled, int listed, char * title, ftw_stage *stage, int debug, int verbose) {
+
+    int res = FTW_TEST_SKIP;
+
+    engine->phase_mask = 0;
+    if (enabled == 0) {
+        res = FTW_TEST_DISA;
+        if (engine->quiet == 0) {
+            fancy_print(title, FTW_TEST_DISA, "", 0);
+        }
+        engine->cnt_disabled++;
+    }
+    else {
+        const char * skip = ftw_stage_skip_reason(stage);
+        if (skip != NULL) {
+            if (engine->quiet == 0) {
+                fancy_print(title, FTW_TEST_SKIP, skip, listed);
+            }
             engine->cnt_skipped++;
         }
         else {
             // if test (collection) is not disabled and shouldn't be skipped
-            int res = engine->runtest(engine, title, stage, debug, verbose);
-            fancy_print(title, res, "", listed);
-            if (res == FTW_TEST_PASS) {
-                engine->cnt_passed++;
-                if (listed == 1) {
-                    engine->cnt_passedwl++;
-                    engine->passed_wl_test_list = realloc(engine->passed_wl_test_list, sizeof(char *) * engine->cnt_passedwl);
-                    engine->passed_wl_test_list[engine->cnt_passedwl - 1] = strdup(title);
-                }
+            unsigned long long key = (engine->cache != NULL) ? ftw_stage_hash(stage) : 0;
+            if (engine->cache != NULL && ftw_cache_lookup(engine->cache, key, &res) == 1) {
+                engine->cnt_cached++;
             }
-            else if (res == FTW_TEST_FAIL && listed == 0) {
-                engine->failed_test_list = realloc(engine->failed_test_list, sizeof(char *) * (engine->cnt_failed + 1));
-                engine->failed_test_list[engine->cnt_failed] = strdup(title);
-                engine->cnt_failed++;
+            else {
+                ftw_dedup_entry * stored = NULL;
+                engine->skip_response_phases = (engine->engine_type != FTW_ENGINE_TYPE_DUMMY && stage_needs_response(engine, stage) == 0) ? 1 : 0;
+                if (engine->dedup != NULL) {
+                    // a pruned request runs less phases, it has its own log
+                    // a hash match alone doesn't reuse a log, the request is compared too
+                    engine->dedup_key = hash_fnv1a(&engine->skip_response_phases, sizeof(int), ftw_request_hash(stage));
+                    free(engine->dedup_request);
+                    engine->dedup_request = ftw_request_serialize(stage, &engine->dedup_request_len);
+                    engine->dedup_request = ftw_dedup_request_mark(engine->dedup_request, &engine->dedup_request_len, engine->skip_response_phases);
+                    stored = ftw_dedup_lookup(engine->dedup, engine->dedup_key, engine->dedup_request, engine->dedup_request_len);
+                }
+                if (engine->skip_response_phases == 1 && stored == NULL) {
+                    engine->cnt_pruned++;
+                }
+                engine->fired_ids_count = 0;
+                ftw_engine_phase_start(engine);
+                if (stored != NULL) {
+                    // the same request was sent already, check its log
+                    logCbLoad(stored->lines, stored->lines_count);
+                    res = ftw_engine_check_log(stage, debug);
+                    ftw_engine_phase_done(engine, FTW_PHASE_CHECK);
+                    logCbFiredIds(engine);
+                    logCbClearLog();
+                    engine->cnt_deduped++;
+                }
+                else {
+                    res = engine_run_stage(engine, title, stage, debug, verbose);
+                }
+                engine_phases_done(engine);
+                if (engine->cache != NULL && res != FTW_TEST_TIMEOUT) {
+                    ftw_cache_store(engine->cache, key, res);
+                }
+                if (engine->fired != NULL && res != FTW_TEST_TIMEOUT) {
+                    ftw_fired_db_add(engine->fired, title, engine->fired_ids, engine->fired_ids_count);
+                }
             }
-            else if (res == FTW_TEST_FAIL && listed == 1) {
-                engine->failed_wl_test_list = realloc(engine->failed_wl_test_list, sizeof(char *) * (engine->cnt_failedwl + 1));
-                engine->failed_wl_test_list[engine->cnt_failedwl] = strdup(title);
-                engine->cnt_failedwl++;
+            unsigned long long output_start = monotonic_ns();
+            if (engine->quiet == 0) {
+                fancy_print(title, res, (res == FTW_TEST_TIMEOUT) ? phase_names[engine->timeout_phase] : "", listed);
             }
+            engine_count_result(engine, listed, title, res);
+            engine->output_ns += monotonic_ns() - output_start;
         }
     }
     engine->cnt_total++;
-    return 0;
+    return res;
+}
+
+// count a result of an earlier run, eg. from the journal
+void engine_replay(ftw_engine * engine, int listed, char * title, int res) {
+    engine->timeout_phase = -1;
+    fancy_print(title, res, "(journal)", (res == FTW_TEST_PASS || res == FTW_TEST_FAIL) ? listed : 0);
+    if (res == FTW_TEST_DISA) {
+        engine->cnt_disabled++;
+    }
+    else if (res == FTW_TEST_SKIP) {
+        engine->cnt_skipped++;
+    }
+    else {
+        engine_count_result(engine, listed, title, res);
+    }
+    engine->cnt_replayed++;
+    engine->cnt_total++;
 }
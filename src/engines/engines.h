@@ -23,6 +23,12 @@
 #define FTW_ENGINES_H
 
 #include "../ftwtest.h"
+#include "../ruleindex.h"
+#include "../ftwcache.h"
+#include "../ftwimpact.h"
+#include "../ftwhistogram.h"
+#include "../ftwalloc.h"
+#include "../ftwperf.h"
 #include "../../config.h"
 
 enum {
@@ -35,13 +41,43 @@ enum {
 #define FTW_TEST_FAIL 1
 #define FTW_TEST_DISA 2
 #define FTW_TEST_SKIP 4
+#define FTW_TEST_TIMEOUT 8
 
 #define GREEN 0
 #define RED 1
 #define END 2
 
+// the timed phases of a transaction, and the evaluation of its log
+enum {
+    FTW_PHASE_CONNECTION = 0,
+    FTW_PHASE_URI,
+    FTW_PHASE_REQUEST_HEADERS,
+    FTW_PHASE_REQUEST_BODY,
+    FTW_PHASE_RESPONSE_HEADERS,
+    FTW_PHASE_RESPONSE_BODY,
+    FTW_PHASE_LOGGING,
+    FTW_PHASE_CHECK,
+    FTW_PHASE_COUNT
+};
+
 typedef struct ftw_engine_t ftw_engine;
 
+// stored log of a request, see '--dedup'
+typedef struct ftw_dedup_entry_t {
+    unsigned long long   key;
+    unsigned char      * request;   // the serialized request, see ftw_request_serialize
+    size_t               request_len;
+    int                  used;
+    char              ** lines;
+    unsigned int         lines_count;
+} ftw_dedup_entry;
+
+typedef struct ftw_dedup_t {
+    ftw_dedup_entry    * entries;   // open addressing, size is a power of 2
+    unsigned int         size;
+    unsigned int         count;
+} ftw_dedup;
+
 typedef struct ftw_runtest_t {
     
 } ftw_runtest;
@@ -59,6 +95,38 @@ typedef struct ftw_engine_t {
     ftw_engine_create_rules_set_fn engine_create_rules_set;
     ftw_engine_cleanup_fn          engine_cleanup;
     ftw_engine_runtest_fn          runtest;
+    int                            stop_on_disruptive;
+    ftw_ruleindex                * ruleindex;
+    int                            skip_response_phases;
+    unsigned long long             response_time_ns;
+    int                            response_count;
+    ftw_cache                    * cache;
+    ftw_fired_db                 * fired;
+    unsigned int                 * fired_ids;       // the rules fired by the last stage
+    unsigned int                   fired_ids_count;
+    ftw_dedup                    * dedup;
+    unsigned long long             dedup_key;       // the request of the current stage
+    unsigned char                * dedup_request;
+    size_t                         dedup_request_len;
+    unsigned long long             phase_ns[FTW_PHASE_COUNT];  // the phases of the last stage
+    unsigned int                   phase_mask;      // the phases run by the last stage
+    unsigned long long             phase_mark;      // the end of the previous phase
+    ftw_histogram                  phase_hist[FTW_PHASE_COUNT];
+    int                            show_phases;
+    unsigned long long             output_ns;       // printing the results
+    int                            alloc_stats;
+    ftw_alloc_counters             alloc_mark;      // the allocations until the end of the previous phase
+    ftw_alloc_counters             phase_alloc[FTW_PHASE_COUNT];  // the phases of the last stage
+    ftw_alloc_counters             phase_alloc_total[FTW_PHASE_COUNT];
+    int                            heap_stats;
+    long long                      heap_mark;       // the heap in use at the start of the transaction
+    long long                      heap_growth;     // the transactions since the caller cleared it
+    int                            quiet;           // don't print the results of the tests
+    ftw_perf                     * perf;            // the counters of the transactions
+    ftw_perf_values                perf_mark;       // the counts at the end of the previous phase
+    ftw_perf_values                perf_stage;      // the transaction of the last stage, without the check
+    unsigned long long             timeout_ns;      // the deadline of the transactions, 0 if none
+    int                            timeout_phase;   // the phase of the last stopped transaction
     int                            cnt_passed;
     int                            cnt_passedwl;
     int                            cnt_failed;
@@ -66,25 +134,46 @@ typedef struct ftw_engine_t {
     int                            cnt_skipped;
     int                            cnt_disabled;
     int                            cnt_total;
+    int                            cnt_pruned;
+    int                            cnt_cached;
+    int                            cnt_deduped;
+    int                            cnt_replayed;
+    int                            cnt_timeout;
+    int                            cnt_not_affected; // not run, not affected by the change of '--affected-by'
     char                        ** failed_test_list;
     char                        ** failed_wl_test_list;
     char                        ** passed_wl_test_list;
+    char                        ** timeout_test_list;
 } ftw_engine;
 
 ftw_engine * ftw_engine_init(int enginetype, char * main_rule_uri, const char ** error);
+ftw_engine * ftw_engine_init_groups(int enginetype, char ** rule_uris, int group_count, const char ** error);
 void         ftw_engine_free(ftw_engine * engine);
+void         ftw_engine_reset(ftw_engine * engine);
 void         ftw_engine_show_result(const ftw_engine * engine);
+const char * ftw_engine_phase_name(int phase);
+const char * ftw_engine_version(const ftw_engine * engine);
 
 static void  fancy_print(const char * test_title, int code, const char * msg, int modifier);
 
 int          qsearch(char **array, int size, const char *key);
 int          engine_runtest(ftw_engine * engine, int enabled, int listed, char * title, ftw_stage *stage, int debug, int verbose);
+void         engine_replay(ftw_engine * engine, int listed, char * title, int res);
 
 void         logCbInit();
 void         logCbCleanup();
 void         logCbText(void *data, const void *msgorig);
 void         logCbDump();
 void         logCbClearLog();
-char       * logContains(char * pattern, int negate);
+void         logCbStageDone(ftw_engine * engine);
+int          ftw_engine_check_log(const ftw_stage * stage, int debug);
+void         ftw_engine_phase_start(ftw_engine * engine);
+void         ftw_engine_phase_done(ftw_engine * engine, int phase);
+
+ftw_dedup       * ftw_dedup_new();
+void              ftw_dedup_free(ftw_dedup * dedup);
+ftw_dedup_entry * ftw_dedup_lookup(const ftw_dedup * dedup, unsigned long long key, const unsigned char * request, size_t request_len);
+void              ftw_dedup_store(ftw_dedup * dedup, unsigned long long key, const unsigned char * request, size_t request_len, const char ** lines, unsigned int lines_count);
+char       * logContains(char * pattern, const char * literal, int negate);
 
 #endif
\ No newline at end of file
@@ -20,6 +20,7 @@
 // Coraza WAF engine for testing
 
 #include "ftwcoraza.h"
+#include "../../ftwtestutils.h"
 
 #ifdef HAVE_LIBCORAZA
 
@@ -67,6 +68,14 @@ void ftw_engine_cleanup_coraza(void * waf) {
     coraza_free_waf((coraza_waf_t)waf);
 }
 
+// coraza_intervention() returns an intervention only if the transaction
+// was interrupted; a real connector stops processing the request there
+// and jumps to logging
+#define STOP_ON_DISRUPTIVE(it) if (it != NULL) { \
+  int disruptive = it->disruptive; \
+  coraza_free_intervention(it); \
+  if (engine->stop_on_disruptive == 1 && disruptive != 0) { goto logging; } }
+
 // run a transaction
 // a stage contains a transaction
 int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stage, int debug, int verbose) {
@@ -82,6 +91,7 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
 
     // phase 0
     coraza_process_connection(transaction, "127.0.0.1", 33333, stage->input->dest_addr, stage->input->port);
+    ftw_engine_phase_done(engine, FTW_PHASE_CONNECTION);
     char version[10] = "1.1";
     if (stage->input->version != NULL) {
         if (strlen(stage->input->version) > 5 && strncmp(stage->input->version, "HTTP/", 5) == 0) {
@@ -91,7 +101,8 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
     }
     coraza_process_uri(transaction, stage->input->uri, stage->input->method, version);
     it = coraza_intervention(transaction);
-    if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_URI);
+    STOP_ON_DISRUPTIVE(it);
 
     // phase 1
     for(int hi = 0; hi < stage->input->headers_len; hi++) {
@@ -106,7 +117,8 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
     coraza_add_request_header(transaction, "X-CRS-Test", 10, title, (int)strlen(title));
     coraza_process_request_headers(transaction);
     it = coraza_intervention(transaction);
-    if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_REQUEST_HEADERS);
+    STOP_ON_DISRUPTIVE(it);
 
     // phase 2
     if (stage->input->data != NULL) {
@@ -114,7 +126,12 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
     }
     coraza_process_request_body(transaction);
     it = coraza_intervention(transaction);
-    if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_REQUEST_BODY);
+    STOP_ON_DISRUPTIVE(it);
+
+    if (engine->skip_response_phases == 1) {
+        goto logging;
+    }
 
     // phase 3
     char response_len[10];
@@ -127,7 +144,8 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
     coraza_add_response_header(transaction, "Content-Length", 14, response_len, (int)strlen(response_len));
     coraza_process_response_headers(transaction, stage->response->response_code, (char *)"HTTP/1.1");
     it = coraza_intervention(transaction);
-    if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_RESPONSE_HEADERS);
+    STOP_ON_DISRUPTIVE(it);
 
     // phase 4
     if (stage->response->response_body != NULL) {
@@ -135,85 +153,23 @@ int ftw_engine_runtest_coraza(ftw_engine * engine, char * title, ftw_stage *stag
     }
     coraza_process_response_body(transaction);
     it = coraza_intervention(transaction);
-    if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_RESPONSE_BODY);
+    STOP_ON_DISRUPTIVE(it);
 
     // phase 5
+logging:
     coraza_process_logging(transaction);
     it = coraza_intervention(transaction);
     if (it != NULL) { coraza_free_intervention(it); }
+    ftw_engine_phase_done(engine, FTW_PHASE_LOGGING);
 
-    //logCbDump();
-    char * log = NULL;
-    if (stage->output->log_contains != NULL) {
-        log = logContains(stage->output->log_contains, 0);
-        if (log != NULL) {
-            ret = FTW_TEST_PASS;
-            if (debug == 1) {
-                printf("%s\n", log);
-            }
-            free(log);
-        }
-        else {
-            ret = FTW_TEST_FAIL;
-            if (debug == 1) {
-                printf("Log no contains required pattern: '%s'\n", stage->output->log_contains);
-            }
-        }
-    }
-    if (stage->output->no_log_contains != NULL) {
-        log = logContains(stage->output->no_log_contains, 1);
-        if (log == NULL) {
-            ret = FTW_TEST_PASS;
-        }
-        else {
-            ret = FTW_TEST_FAIL;
-            if (debug == 1) {
-                printf("%s\n", log);
-            }
-            free(log);
-        }
-    }
-    if (stage->output->log->expect_ids_len > 0) {
-        for(int i = 0; i < stage->output->log->expect_ids_len; i++) {
-            char idsubj[50];
-            sprintf(idsubj, "id \"%u\"", stage->output->log->expect_ids[i]);
-            log = logContains(idsubj, 0);
-            if (log != NULL) {
-                ret = FTW_TEST_PASS;
-                if (debug == 1) {
-                    printf("%s\n", log);
-                }
-                free(log);
-            }
-            else {
-                ret = FTW_TEST_FAIL;
-                if (debug == 1) {
-                    printf("Log no contains required pattern: '%s'\n", idsubj);
-                }
-            }
-        }
-    }
-    if (stage->output->log->no_expect_ids_len > 0) {
-        for(int i = 0; i < stage->output->log->no_expect_ids_len; i++) {
-            char idsubj[50];
-            sprintf(idsubj, "id \"%u\"", stage->output->log->no_expect_ids[i]);
-            log = logContains(idsubj, 1);
-            if (log == NULL) {
-                ret = FTW_TEST_PASS;
-            }
-            else {
-                ret = FTW_TEST_FAIL;
-                if (debug == 1) {
-                    printf("%s\n", log);
-                }
-                free(log);
-            }
-        }
-    }
+    ret = ftw_engine_check_log(stage, debug);
+    ftw_engine_phase_done(engine, FTW_PHASE_CHECK);
 
     coraza_free_transaction(transaction);
 
     logCbDump();
+    logCbStageDone(engine);
     logCbClearLog();
 
     return ret;
@@ -20,6 +20,7 @@
 // ModSecurity WAF engine for testing
 
 #include "ftwmodsecurity.h"
+#include "../../ftwtestutils.h"
 
 #ifdef HAVE_MODSECURITY
 
@@ -46,6 +47,34 @@ void * ftw_engine_create_rules_set_msc(void * engine_instance, char * main_rule_
     return (void*)rules;
 }
 
+// set the rules from groups of rule files
+// every group is loaded into an own rules set, then the sets are merged in
+// the original order
+// the SecLang scanner of libmodsecurity keeps its state in global variables,
+// so the groups are parsed one by one: this is a check of the split and the
+// merge, not a faster load
+void * ftw_engine_create_rules_set_groups_msc(void * engine_instance, char ** rule_uris, int group_count, const char ** error) {
+#ifdef MSC_USE_RULES_SET
+    RulesSet * rules = msc_create_rules_set();
+#else
+    Rules    * rules = msc_create_rules_set();
+#endif
+
+    for (int i = 0; i < group_count && rules != NULL; i++) {
+        void * group = ftw_engine_create_rules_set_msc(engine_instance, rule_uris[i], error);
+        if (group != NULL && msc_rules_merge(rules, group, error) >= 0) {
+            msc_rules_cleanup(group);
+            continue;
+        }
+        if (group != NULL) {
+            msc_rules_cleanup(group);
+        }
+        msc_rules_cleanup(rules);
+        rules = NULL;
+    }
+    return (void*)rules;
+}
+
 // cleanup the WAF engine
 void ftw_engine_cleanup_msc(void * modsec) {
     msc_cleanup((ModSecurity *)modsec);
@@ -54,6 +83,12 @@ void ftw_engine_cleanup_msc(void * modsec) {
 #define VERBOSE(format, ...) if (verbose == 1) { \
   fprintf(stdout, "\033[35;46mVERBOSE\033[0m " format, __VA_ARGS__); }
 
+// a real connector (eg. nginx in blocking mode) stops processing the
+// request at the first disruptive intervention and jumps to logging
+#define STOP_ON_DISRUPTIVE(phase) if (engine->stop_on_disruptive == 1 && it.disruptive != 0) { \
+  VERBOSE("disruptive intervention in phase %d, skip to logging\n", phase); \
+  goto logging; }
+
 // run a transaction
 // a stage contains a transaction
 int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage, int debug, int verbose) {
@@ -82,6 +117,7 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     if (verbose == 1) {
         printf("\033[35;46mVERBOSE\033[0m Connection data: source addr: 127.0.0.1, source port: 33333, dest addr: %s, dest port: %u\n", stage->input->dest_addr, stage->input->port);
     }
+    ftw_engine_phase_done(engine, FTW_PHASE_CONNECTION);
     char version[10] = "1.1";
     if (stage->input->version != NULL) {
         if (strlen(stage->input->version) > 5 && strncmp(stage->input->version, "HTTP/", 5) == 0) {
@@ -97,6 +133,8 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     if (verbose == 1) {
         printf("\033[35;46mVERBOSE\033[0m intervention: status: %d, disruptive: %d\n", it.status, it.disruptive);
     }
+    ftw_engine_phase_done(engine, FTW_PHASE_URI);
+    STOP_ON_DISRUPTIVE(0);
 
     // phase 1
     for(int hi = 0; hi < stage->input->headers_len; hi++) {
@@ -114,6 +152,8 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     if (verbose == 1) {
         printf("\033[35;46mVERBOSE\033[0m intervention: status phase 1: %d, disruptive: %d\n", it.status, it.disruptive);
     }
+    ftw_engine_phase_done(engine, FTW_PHASE_REQUEST_HEADERS);
+    STOP_ON_DISRUPTIVE(1);
 
     // phase 2
     if (stage->input->data != NULL) {
@@ -128,6 +168,13 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
         printf("\033[35;46mVERBOSE\033[0m intervention: status, phase 2: %d, disruptive: %d\n", it.status, it.disruptive);
         //printf("\033[35;46mVERBOSE\033[0m intervention: log: '%s'\n", it.log);
     }
+    ftw_engine_phase_done(engine, FTW_PHASE_REQUEST_BODY);
+    STOP_ON_DISRUPTIVE(2);
+
+    if (engine->skip_response_phases == 1) {
+        VERBOSE("%s\n", "no assertion depends on the response phases, skip to logging");
+        goto logging;
+    }
 
     // phase 3
     char response_len[10];
@@ -151,6 +198,8 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     msc_process_response_headers(transaction, stage->response->response_code, (const char *)"HTTP/1.1");
     msc_intervention(transaction, &it);
     VERBOSE("intervention: status, phase 3: %d, disruptive: %d\n", it.status, it.disruptive);
+    ftw_engine_phase_done(engine, FTW_PHASE_RESPONSE_HEADERS);
+    STOP_ON_DISRUPTIVE(3);
 
     // phase 4
     if (stage->response->response_body != NULL) {
@@ -160,83 +209,18 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     msc_process_response_body(transaction);
     msc_intervention(transaction, &it);
     VERBOSE("intervention: status, phase 4: %d, disruptive: %d\n", it.status, it.disruptive);
+    ftw_engine_phase_done(engine, FTW_PHASE_RESPONSE_BODY);
+    STOP_ON_DISRUPTIVE(4);
 
     // phase 5
+logging:
     msc_process_logging(transaction);
     msc_intervention(transaction, &it);
     VERBOSE("intervention: status, phase 5: %d, disruptive: %d\n", it.status, it.disruptive);
+    ftw_engine_phase_done(engine, FTW_PHASE_LOGGING);
 
-    //logCbDump();
-    char * log = NULL;
-    if (stage->output->log_contains != NULL) {
-        log = logContains(stage->output->log_contains, 0);
-        if (log != NULL) {
-            ret = FTW_TEST_PASS;
-            if (debug == 1) {
-                printf("%s\n", log);
-            }
-            free(log);
-        }
-        else {
-            ret = FTW_TEST_FAIL;
-            if (debug == 1) {
-                printf("Log no contains required pattern: '%s'\n", stage->output->log_contains);
-            }
-        }
-    }
-    if (stage->output->no_log_contains != NULL) {
-        log = logContains(stage->output->no_log_contains, 1);
-        if (log == NULL) {
-            ret = FTW_TEST_PASS;
-        }
-        else {
-            ret = FTW_TEST_FAIL;
-            if (debug == 1) {
-                printf("%s\n", log);
-            }
-            free(log);
-        }
-    }
-    if (stage->output->log->expect_ids_len > 0) {
-        for(int i = 0; i < stage->output->log->expect_ids_len; i++) {
-
-            char idsubj[50];
-            sprintf(idsubj, "id \"%u\"", stage->output->log->expect_ids[i]);
-            log = logContains(idsubj, 0);
-            if (log != NULL) {
-                ret = FTW_TEST_PASS;
-                if (debug == 1) {
-                    printf("%s\n", log);
-                }
-                free(log);
-            }
-            else {
-                ret = FTW_TEST_FAIL;
-                if (debug == 1) {
-                    printf("Log no contains required pattern: '%s'\n", idsubj);
-                }
-            }
-        }
-    }
-    if (stage->output->log->no_expect_ids_len > 0) {
-        for(int i = 0; i < stage->output->log->no_expect_ids_len; i++) {
-
-            char idsubj[50];
-            sprintf(idsubj, "id \"%u\"", stage->output->log->no_expect_ids[i]);
-            log = logContains(idsubj, 1);
-            if (log == NULL) {
-                ret = FTW_TEST_PASS;
-            }
-            else {
-                ret = FTW_TEST_FAIL;
-                if (debug == 1) {
-                    printf("%s\n", log);
-                }
-                free(log);
-            }
-        }
-    }
-
+    ret = ftw_engine_check_log(stage, debug);
+    ftw_engine_phase_done(engine, FTW_PHASE_CHECK);
 
     if (it.url != NULL) {
         free(it.url);
@@ -247,6 +231,7 @@ int ftw_engine_runtest_msc(ftw_engine * engine, char * title, ftw_stage *stage,
     msc_transaction_cleanup(transaction);
 
     //logCbDump();
+    logCbStageDone(engine);
     logCbClearLog();
 
     return ret;
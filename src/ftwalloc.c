@@ -0,0 +1,303 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwalloc.c
+// allocation accounting: counters of the malloc family
+//
+// if it's enabled by 'configure --enable-alloc-stats', the malloc family of
+// the whole process (the engines too) is interposed here with glibc, and
+// the calls are forwarded to the glibc allocator; the calls are counted
+// only after ftw_alloc_enable(), until then the wrappers only forward them
+// the interposer replaces the allocator of the sanitizers too, so it's off
+// by default
+// the bytes in use aren't tracked by the wrappers, a block can be freed
+// after the enable but allocated before it; they are taken from mallinfo2()
+// without the interposer too
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "config.h"
+#include "ftwalloc.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(__GLIBC__) && defined(ENABLE_ALLOC_STATS)
+
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+extern void * __libc_memalign(size_t alignment, size_t size);
+extern void * __libc_valloc(size_t size);
+extern void * __libc_pvalloc(size_t size);
+extern void   __libc_free(void * ptr);
+
+static int                  alloc_enabled = 0;
+static ftw_alloc_counters   alloc_counters;
+
+#define ALLOC_COUNT(field, n) __atomic_add_fetch(&alloc_counters.field, (n), __ATOMIC_RELAXED)
+
+// count a new block
+static inline void alloc_count(void * ptr, size_t size) {
+    if (alloc_enabled == 1 && ptr != NULL) {
+        ALLOC_COUNT(allocs, 1);
+        ALLOC_COUNT(bytes, size);
+    }
+}
+
+void * malloc(size_t size) {
+    void * ptr;
+
+    ptr = __libc_malloc(size);
+    alloc_count(ptr, size);
+    return ptr;
+}
+
+void * calloc(size_t nmemb, size_t size) {
+    void * ptr;
+
+    ptr = __libc_calloc(nmemb, size);
+    alloc_count(ptr, nmemb * size);
+    return ptr;
+}
+
+// only the growth of a block is counted in the requested bytes
+void * realloc(void * ptr, size_t size) {
+    size_t oldsize = (alloc_enabled == 1 && ptr != NULL) ? malloc_usable_size(ptr) : 0;
+    void * newptr;
+
+    newptr = __libc_realloc(ptr, size);
+    if (alloc_enabled == 1) {
+        if (ptr == NULL && newptr != NULL) {
+            ALLOC_COUNT(allocs, 1);
+        }
+        else if (size == 0) {
+            ALLOC_COUNT(frees, 1);
+        }
+        if (newptr != NULL && size > oldsize) {
+            ALLOC_COUNT(bytes, size - oldsize);
+        }
+    }
+    return newptr;
+}
+
+void * memalign(size_t alignment, size_t size) {
+    void * ptr;
+
+    ptr = __libc_memalign(alignment, size);
+    alloc_count(ptr, size);
+    return ptr;
+}
+
+void * aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void ** memptr, size_t alignment, size_t size) {
+    void * ptr;
+
+    // the alignment must be a power of two multiple of sizeof(void *)
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+        return EINVAL;
+    }
+    if ((ptr = memalign(alignment, size)) == NULL) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void * valloc(size_t size) {
+    void * ptr;
+
+    ptr = __libc_valloc(size);
+    alloc_count(ptr, size);
+    return ptr;
+}
+
+void * pvalloc(size_t size) {
+    void * ptr;
+
+    ptr = __libc_pvalloc(size);
+    alloc_count(ptr, size);
+    return ptr;
+}
+
+void free(void * ptr) {
+    if (alloc_enabled == 1 && ptr != NULL) {
+        ALLOC_COUNT(frees, 1);
+    }
+    __libc_free(ptr);
+}
+
+int ftw_alloc_available(void) {
+    return 1;
+}
+
+void ftw_alloc_enable(void) {
+    alloc_enabled = 1;
+}
+
+void ftw_alloc_snapshot(ftw_alloc_counters * counters) {
+    counters->allocs = __atomic_load_n(&alloc_counters.allocs, __ATOMIC_RELAXED);
+    counters->frees  = __atomic_load_n(&alloc_counters.frees, __ATOMIC_RELAXED);
+    counters->bytes  = __atomic_load_n(&alloc_counters.bytes, __ATOMIC_RELAXED);
+}
+
+#else
+
+int ftw_alloc_available(void) {
+    return 0;
+}
+
+void ftw_alloc_enable(void) {
+}
+
+void ftw_alloc_snapshot(ftw_alloc_counters * counters) {
+    memset(counters, 0, sizeof(ftw_alloc_counters));
+}
+
+#endif
+
+#ifdef __GLIBC__
+
+int ftw_alloc_heap_available(void) {
+    return 1;
+}
+
+// the bytes of the blocks in use, the mmap()-ed ones too
+// it walks the free lists of the arenas, so it isn't called per phase
+long long ftw_alloc_heap(void) {
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo  mi = mallinfo();
+#endif
+    return (long long)mi.uordblks + (long long)mi.hblkhd;
+}
+
+#else
+
+int ftw_alloc_heap_available(void) {
+    return 0;
+}
+
+long long ftw_alloc_heap(void) {
+    return 0;
+}
+
+#endif
+
+void ftw_alloc_delta(ftw_alloc_counters * delta, const ftw_alloc_counters * from, const ftw_alloc_counters * to) {
+    delta->allocs = to->allocs - from->allocs;
+    delta->frees  = to->frees - from->frees;
+    delta->bytes  = to->bytes - from->bytes;
+}
+
+// add the allocations of a stage of a test
+// the stages of a test are added after each other
+void ftw_alloc_report_add(ftw_alloc_report * report, const char * test, unsigned int rule_id, const ftw_alloc_counters * used) {
+    ftw_alloc_test * rec = (report->count > 0) ? &report->tests[report->count - 1] : NULL;
+
+    if (rec == NULL || strcmp(rec->test, test) != 0) {
+        if (report->count == report->allocated) {
+            unsigned int     allocated = (report->allocated == 0) ? 256 : report->allocated * 2;
+            ftw_alloc_test * tests     = realloc(report->tests, sizeof(ftw_alloc_test) * allocated);
+            if (tests == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            report->tests     = tests;
+            report->allocated = allocated;
+        }
+        rec = &report->tests[report->count++];
+        memset(rec, 0, sizeof(ftw_alloc_test));
+        snprintf(rec->test, sizeof(rec->test), "%s", test);
+        rec->rule_id = rule_id;
+    }
+    rec->used.allocs += used->allocs;
+    rec->used.frees  += used->frees;
+    rec->used.bytes  += used->bytes;
+}
+
+// the most bytes first
+static int alloc_test_cmp(const void *p1, const void *p2) {
+    const ftw_alloc_test * a = p1;
+    const ftw_alloc_test * b = p2;
+    return (a->used.bytes < b->used.bytes) - (a->used.bytes > b->used.bytes);
+}
+
+static int alloc_rule_cmp(const void *p1, const void *p2) {
+    const ftw_alloc_test * a = p1;
+    const ftw_alloc_test * b = p2;
+    return (a->rule_id > b->rule_id) - (a->rule_id < b->rule_id);
+}
+
+static void alloc_show(const ftw_alloc_test * tests, unsigned int count, unsigned int top, int rules) {
+    for (unsigned int i = 0; i < count && i < top; i++) {
+        char name[50];
+        if (rules == 1) {
+            snprintf(name, sizeof(name), "%u", tests[i].rule_id);
+        }
+        printf("%-23s %10llu %10llu %12llu\n", (rules == 1) ? name : tests[i].test, tests[i].used.allocs, tests[i].used.frees, tests[i].used.bytes);
+    }
+    printf("===============================\n");
+}
+
+// show the tests and the rules with the most allocated bytes
+void ftw_alloc_report_show(const ftw_alloc_report * report, unsigned int top) {
+    ftw_alloc_test * tests = malloc(sizeof(ftw_alloc_test) * (report->count + 1));
+    unsigned int     rules = 0;
+
+    if (tests == NULL) {
+        return;
+    }
+    memcpy(tests, report->tests, sizeof(ftw_alloc_test) * report->count);
+    qsort(tests, report->count, sizeof(ftw_alloc_test), alloc_test_cmp);
+    printf("ALLOCATING TESTS            allocs      frees        bytes\n");
+    alloc_show(tests, report->count, top, 0);
+
+    // sum the tests of the rules
+    qsort(tests, report->count, sizeof(ftw_alloc_test), alloc_rule_cmp);
+    for (unsigned int i = 0; i < report->count; i++) {
+        if (rules > 0 && tests[rules - 1].rule_id == tests[i].rule_id) {
+            tests[rules - 1].used.allocs += tests[i].used.allocs;
+            tests[rules - 1].used.frees  += tests[i].used.frees;
+            tests[rules - 1].used.bytes  += tests[i].used.bytes;
+        }
+        else {
+            tests[rules++] = tests[i];
+        }
+    }
+    qsort(tests, rules, sizeof(ftw_alloc_test), alloc_test_cmp);
+    printf("ALLOCATING RULES            allocs      frees        bytes\n");
+    alloc_show(tests, rules, top, 1);
+    free(tests);
+}
+
+void ftw_alloc_report_free(ftw_alloc_report * report) {
+    if (report != NULL) {
+        free(report->tests);
+        free(report);
+    }
+}
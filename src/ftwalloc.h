@@ -0,0 +1,56 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwalloc.h
+// allocation accounting: counters of the malloc family
+//
+
+#ifndef _FTWALLOC_H
+#define _FTWALLOC_H
+
+typedef struct ftw_alloc_counters_t {
+    unsigned long long   allocs;       // malloc, calloc, the aligned ones, and realloc of NULL
+    unsigned long long   frees;
+    unsigned long long   bytes;        // requested bytes, only the growth by realloc
+} ftw_alloc_counters;
+
+typedef struct ftw_alloc_test_t {
+    char                 test[50];
+    unsigned int         rule_id;
+    ftw_alloc_counters   used;
+} ftw_alloc_test;
+
+// the allocations of the transactions of the tests
+typedef struct ftw_alloc_report_t {
+    ftw_alloc_test     * tests;
+    unsigned int         count;
+    unsigned int         allocated;
+} ftw_alloc_report;
+
+int  ftw_alloc_available(void);         // the interposer is built in
+int  ftw_alloc_heap_available(void);
+void ftw_alloc_enable(void);
+void ftw_alloc_snapshot(ftw_alloc_counters * counters);
+long long ftw_alloc_heap(void);     // the bytes in use on the heap
+void ftw_alloc_delta(ftw_alloc_counters * delta, const ftw_alloc_counters * from, const ftw_alloc_counters * to);
+
+void ftw_alloc_report_add(ftw_alloc_report * report, const char * test, unsigned int rule_id, const ftw_alloc_counters * used);
+void ftw_alloc_report_show(const ftw_alloc_report * report, unsigned int top);
+void ftw_alloc_report_free(ftw_alloc_report * report);
+
+#endif
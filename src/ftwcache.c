@@ -0,0 +1,174 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwcache.c
+// on-disk cache of the test results
+//
+// the file has a header line with the hash of the environment (config
+// files, engine and options), and a line for every result:
+//   <key in hex> <result>
+// the results of other environments are dropped when the file is loaded
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ftwcache.h"
+
+#define FTW_CACHE_INITIAL_SIZE 1024
+
+// find the slot of a key
+static ftw_cache_entry * cache_slot(const ftw_cache * cache, unsigned long long key) {
+    unsigned int i = (unsigned int)(key ^ (key >> 32)) & (cache->size - 1);
+
+    while (cache->entries[i].key != 0 && cache->entries[i].key != key) {
+        i = (i + 1) & (cache->size - 1);
+    }
+    return &cache->entries[i];
+}
+
+// double the size of the table
+static int cache_grow(ftw_cache * cache) {
+    ftw_cache_entry * old      = cache->entries;
+    unsigned int      old_size = cache->size;
+
+    cache->entries = calloc(old_size * 2, sizeof(ftw_cache_entry));
+    if (cache->entries == NULL) {
+        cache->entries = old;
+        return -1;
+    }
+    cache->size = old_size * 2;
+    for (unsigned int i = 0; i < old_size; i++) {
+        if (old[i].key != 0) {
+            *cache_slot(cache, old[i].key) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+// open the cache, and load the results of the same environment
+// a missing file is an empty cache
+// returns NULL on memory allocation error
+ftw_cache * ftw_cache_open(const char * path, unsigned long long env, int reverify) {
+    ftw_cache * cache = calloc(1, sizeof(ftw_cache));
+    FILE      * fp;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->path     = strdup(path);
+    cache->env      = env;
+    cache->reverify = reverify;
+    cache->size     = FTW_CACHE_INITIAL_SIZE;
+    cache->entries  = calloc(cache->size, sizeof(ftw_cache_entry));
+    if (cache->path == NULL || cache->entries == NULL) {
+        ftw_cache_free(cache);
+        return NULL;
+    }
+
+    if ((fp = fopen(path, "r")) != NULL) {
+        char               line[128];
+        unsigned long long file_env = 0;
+
+        if (fgets(line, sizeof(line), fp) != NULL
+            && strncmp(line, FTW_CACHE_MAGIC " ", strlen(FTW_CACHE_MAGIC) + 1) == 0
+            && sscanf(line + strlen(FTW_CACHE_MAGIC) + 1, "%llx", &file_env) == 1
+            && file_env == env) {
+            while (fgets(line, sizeof(line), fp) != NULL) {
+                unsigned long long key;
+                int                result;
+                if (sscanf(line, "%llx %d", &key, &result) == 2 && key != 0) {
+                    ftw_cache_store(cache, key, result);
+                }
+            }
+        }
+        fclose(fp);
+    }
+    return cache;
+}
+
+void ftw_cache_free(ftw_cache * cache) {
+    if (cache != NULL) {
+        free(cache->path);
+        free(cache->entries);
+        free(cache);
+    }
+}
+
+// look up a result
+// returns 1 if the result is found
+int ftw_cache_lookup(ftw_cache * cache, unsigned long long key, int * result) {
+    const ftw_cache_entry * entry;
+
+    if (cache->reverify == 1 || key == 0) {
+        return 0;
+    }
+    entry = cache_slot(cache, key);
+    if (entry->key == 0) {
+        return 0;
+    }
+    *result = entry->result;
+    cache->hits++;
+    return 1;
+}
+
+// store a result
+void ftw_cache_store(ftw_cache * cache, unsigned long long key, int result) {
+    ftw_cache_entry * entry;
+
+    if (key == 0) {
+        return;
+    }
+    // keep the load factor under 0.5
+    if ((cache->count + 1) * 2 > cache->size && cache_grow(cache) != 0) {
+        return;
+    }
+    entry = cache_slot(cache, key);
+    if (entry->key == 0) {
+        entry->key = key;
+        cache->count++;
+    }
+    entry->result = result;
+}
+
+// write the cache into a temporary file, and rename it to the cache file
+// returns 0, or -1 on error
+int ftw_cache_save(const ftw_cache * cache) {
+    char   tmppath[PATH_MAX];
+    FILE * fp;
+    int    rc = 0;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", cache->path);
+    if ((fp = fopen(tmppath, "w")) == NULL) {
+        return -1;
+    }
+    fprintf(fp, "%s %016llx\n", FTW_CACHE_MAGIC, cache->env);
+    for (unsigned int i = 0; i < cache->size; i++) {
+        if (cache->entries[i].key != 0) {
+            fprintf(fp, "%016llx %d\n", cache->entries[i].key, cache->entries[i].result);
+        }
+    }
+    if (fclose(fp) != 0 || rename(tmppath, cache->path) != 0) {
+        remove(tmppath);
+        rc = -1;
+    }
+    return rc;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwcache.h
+// on-disk cache of the test results
+//
+
+#ifndef _FTWCACHE_H
+#define _FTWCACHE_H
+
+#define FTWRUNNER_CACHE ".ftwrunner.cache"
+
+#define FTW_CACHE_MAGIC "ftwrunner-cache 1"
+
+typedef struct ftw_cache_entry_t {
+    unsigned long long key;    // 0 is an empty slot
+    int                result;
+} ftw_cache_entry;
+
+typedef struct ftw_cache_t {
+    char              * path;
+    unsigned long long  env;       // hash of the config, the engine and the options
+    ftw_cache_entry   * entries;   // open addressing hash table
+    unsigned int        size;      // power of 2
+    unsigned int        count;
+    int                 reverify;  // don't use the stored results
+    unsigned int        hits;
+} ftw_cache;
+
+ftw_cache * ftw_cache_open(const char * path, unsigned long long env, int reverify);
+void        ftw_cache_free(ftw_cache * cache);
+int         ftw_cache_lookup(ftw_cache * cache, unsigned long long key, int * result);
+void        ftw_cache_store(ftw_cache * cache, unsigned long long key, int result);
+int         ftw_cache_save(const ftw_cache * cache);
+
+#endif
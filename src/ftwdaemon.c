@@ -0,0 +1,320 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwdaemon.c
+// unix socket server and client for the daemon mode
+//
+// the client sends one request line, the daemon sends back the output
+// of the request, a '\0' byte and the exit code in a line
+// the requests run with the rules loaded once by the daemon
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <limits.h>
+
+#include "ftwdaemon.h"
+#include "ftwrun.h"
+#include "ftwtestutils.h"
+#include "walkdir.h"
+
+// connect to the socket
+// returns the fd, or -1 on error
+static int daemon_connect(const char * socket_path) {
+    struct sockaddr_un addr;
+    int                fd;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// read the request line
+// returns the length of the request, -1 on error, or -2 if the request
+// is longer than FTW_DAEMON_MAXREQUEST - 1
+static int daemon_read_request(int fd, char * request) {
+    int len = 0;
+
+    while (1) {
+        char    c;
+        ssize_t n = read(fd, &c, 1);
+        if (n <= 0) {
+            return -1;
+        }
+        if (c == '\n') {
+            break;
+        }
+        if (len == FTW_DAEMON_MAXREQUEST - 1) {
+            return -2;
+        }
+        request[len++] = c;
+    }
+    request[len] = '\0';
+    return len;
+}
+
+// listen on the socket, and run the requests with the handler
+// returns 0 if the daemon was stopped by a request, -1 on error
+int ftw_daemon_serve(const char * socket_path, ftw_daemon_handler_fn handler, void * ctx) {
+    struct sockaddr_un addr;
+    int                fd;
+    int                stop = 0;
+    int                err  = 0;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path is too long: %s\n", socket_path);
+        return -1;
+    }
+    if ((fd = daemon_connect(socket_path)) >= 0) {
+        close(fd);
+        fprintf(stderr, "Error: a daemon is already listening on %s\n", socket_path);
+        return -1;
+    }
+    // stale socket of a killed daemon
+    unlink(socket_path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    // a client can disconnect before the end of the output
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on %s\n", socket_path);
+    fflush(stdout);
+
+    while (stop == 0) {
+        char request[FTW_DAEMON_MAXREQUEST];
+        int  client = accept(fd, NULL, NULL);
+        int  rc;
+        int  saved_stdout;
+        int  saved_stderr;
+
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            err = -1;
+            break;
+        }
+        if ((rc = daemon_read_request(client, request)) < 0) {
+            // a truncated request would run an other selection
+            if (rc == -2) {
+                dprintf(client, "Error: the request is longer than %d bytes!\n%c%d\n", FTW_DAEMON_MAXREQUEST - 1, '\0', EXIT_FAILURE);
+            }
+            close(client);
+            continue;
+        }
+
+        // the output of the request goes to the client
+        fflush(stdout);
+        fflush(stderr);
+        saved_stdout = dup(STDOUT_FILENO);
+        saved_stderr = dup(STDERR_FILENO);
+        dup2(client, STDOUT_FILENO);
+        dup2(client, STDERR_FILENO);
+
+        rc = handler(ctx, request);
+
+        fflush(stdout);
+        fflush(stderr);
+        dup2(saved_stdout, STDOUT_FILENO);
+        dup2(saved_stderr, STDERR_FILENO);
+        close(saved_stdout);
+        close(saved_stderr);
+
+        dprintf(client, "%c%d\n", '\0', (rc < 0) ? 0 : rc);
+        close(client);
+        stop = (rc < 0) ? 1 : 0;
+    }
+    close(fd);
+    unlink(socket_path);
+    return err;
+}
+
+// send a request to the daemon, and copy the output to stdout
+// returns the exit code sent by the daemon, or -1 on error
+int ftw_daemon_send(const char * socket_path, const char * request) {
+    char    buffer[4096];
+    char    code[16];
+    size_t  code_len = 0;
+    int     in_code  = 0;
+    ssize_t n;
+    int     fd = daemon_connect(socket_path);
+
+    if (fd < 0) {
+        fprintf(stderr, "Error: can't connect to the daemon on %s: %s\n", socket_path, strerror(errno));
+        return -1;
+    }
+    if (write(fd, request, strlen(request)) < 0 || write(fd, "\n", 1) < 0) {
+        perror("write");
+        close(fd);
+        return -1;
+    }
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (in_code == 1) {
+                if (code_len < sizeof(code) - 1) {
+                    code[code_len++] = buffer[i];
+                }
+            }
+            else if (buffer[i] == '\0') {
+                in_code = 1;
+            }
+            else {
+                fputc(buffer[i], stdout);
+            }
+        }
+    }
+    close(fd);
+    fflush(stdout);
+    if (in_code == 0) {
+        fprintf(stderr, "Error: the daemon closed the connection\n");
+        return -1;
+    }
+    code[code_len] = '\0';
+    return atoi(code);
+}
+
+// send the request of '--client', '--reload' or '--stop' to the daemon
+// the daemon has the config, only the selection is sent
+// returns the exit code of the request, or -1 on error
+int ftw_daemon_client(const char * socket_path, const char * req, const ftw_run_opts * opts) {
+    char request[FTW_DAEMON_MAXREQUEST];
+    char rootdir[PATH_MAX];
+    int  len;
+
+    if (opts->ftwtest_root != NULL && realpath(opts->ftwtest_root, rootdir) == NULL) {
+        fprintf(stderr, "Error: %s not found!\n", opts->ftwtest_root);
+        return -1;
+    }
+    len = snprintf(request, sizeof(request), "%s" FTW_DAEMON_SEP "%s" FTW_DAEMON_SEP "%u" FTW_DAEMON_SEP "%u" FTW_DAEMON_SEP "%d" FTW_DAEMON_SEP "%d" FTW_DAEMON_SEP "%s",
+        req, (opts->ftwtest_root != NULL) ? rootdir : "-", opts->rule_test, opts->rule_test_id, opts->debug, opts->verbose,
+        (opts->select_expr != NULL) ? opts->select_expr : "-");
+    if (len >= (int)sizeof(request)) {
+        fprintf(stderr, "Error: the request to the daemon is longer than %d bytes, use a shorter selection!\n", FTW_DAEMON_MAXREQUEST - 1);
+        return -1;
+    }
+    return ftw_daemon_send(socket_path, request);
+}
+
+// handle a request of a client
+// run: run the selected tests with the loaded rules
+// reload: load the rules again if a config file has been changed
+// stop: stop the daemon
+int ftw_daemon_handler(void * ctx, char * request) {
+    ftw_daemon_ctx * daemon = (ftw_daemon_ctx *)ctx;
+    char           * saveptr = NULL;
+    char           * cmd     = strtok_r(request, FTW_DAEMON_SEP, &saveptr);
+
+    if (cmd == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (strcmp(cmd, FTW_DAEMON_REQ_RUN) == 0) {
+        // run <ftwtest_root> <rule> <test> <debug> <verbose> <selection>, '-' is the default
+        ftw_run_opts opts = *daemon->opts;
+        char       * arg;
+        char         rootdir[1024];
+        char      ** tests      = NULL;
+        unsigned     test_count = 0;
+
+        if ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL && strcmp(arg, "-") != 0) {
+            opts.ftwtest_root = arg;
+        }
+        opts.rule_test    = ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL) ? atoi(arg) : 0;
+        opts.rule_test_id = ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL) ? atoi(arg) : 0;
+        opts.debug        = ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL) ? atoi(arg) : 0;
+        opts.verbose      = ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL) ? atoi(arg) : 0;
+        if ((arg = strtok_r(NULL, FTW_DAEMON_SEP, &saveptr)) != NULL && strcmp(arg, "-") != 0) {
+            const char * errormsg = NULL;
+            if ((opts.selection = ftw_selection_compile(arg, &errormsg)) == NULL) {
+                fprintf(stderr, "Error: invalid selection '%s': %s\n", arg, errormsg);
+                return EXIT_FAILURE;
+            }
+        }
+
+        snprintf(rootdir, sizeof(rootdir), "%s", opts.ftwtest_root);
+        walkdir(rootdir, &tests, &test_count);
+        if (tests == NULL) {
+            printf("No tests found!\n");
+            return EXIT_SUCCESS;
+        }
+        ftw_engine_reset(daemon->engine);
+        int rc = ftw_run_tests(daemon->engine, NULL, &opts, tests, test_count);
+        if (opts.selection != daemon->opts->selection) {
+            ftw_selection_free(opts.selection);
+        }
+        return rc;
+    }
+    else if (strcmp(cmd, FTW_DAEMON_REQ_RELOAD) == 0) {
+        ftw_ruleindex      * ruleindex = ftw_run_index_rules(daemon->opts, 1);
+        unsigned long long   sig       = ftw_run_config_signature(ruleindex, daemon->opts->modsecurity_config);
+        const char         * errormsg  = NULL;
+
+        if (sig == daemon->config_signature) {
+            ftw_ruleindex_free(ruleindex);
+            printf("Rules are up to date\n");
+            return EXIT_SUCCESS;
+        }
+        unsigned long long load_start = monotonic_ns();
+        ftw_engine * engine = ftw_run_load_engine(daemon->opts, ruleindex, &errormsg);
+        if (engine == NULL) {
+            fprintf(stderr, "ftwrunner init error: %s\n", errormsg);
+            fprintf(stderr, "The previous rules are kept\n");
+            return EXIT_FAILURE;
+        }
+        ftw_engine_free(daemon->engine);
+        daemon->engine           = engine;
+        daemon->config_signature = sig;
+        printf("Rules reloaded in %.2f ms\n", (double)(monotonic_ns() - load_start) / 1000000.0);
+        return EXIT_SUCCESS;
+    }
+    else if (strcmp(cmd, FTW_DAEMON_REQ_STOP) == 0) {
+        printf("Daemon stopped\n");
+        return -1;
+    }
+    fprintf(stderr, "Error: unknown request: %s\n", cmd);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwdaemon.h
+// unix socket server and client for the daemon mode
+//
+
+#ifndef _FTWDAEMON_H
+#define _FTWDAEMON_H
+
+#include "engines/engines.h"
+
+struct ftw_run_opts_t;
+
+#define FTWRUNNER_SOCKET ".ftwrunner.sock"
+
+#define FTW_DAEMON_MAXREQUEST 8192
+
+// request fields are separated by FTW_DAEMON_SEP
+#define FTW_DAEMON_SEP "\t"
+
+#define FTW_DAEMON_REQ_RUN    "run"
+#define FTW_DAEMON_REQ_RELOAD "reload"
+#define FTW_DAEMON_REQ_STOP   "stop"
+
+// the handler runs a request, its stdout and stderr are sent to the client
+// it returns the exit code for the client, or a negative value to stop
+// the daemon
+typedef int (*ftw_daemon_handler_fn)(void * ctx, char * request);
+
+// state of the daemon, the context of ftw_daemon_handler()
+typedef struct ftw_daemon_ctx_t {
+    const struct ftw_run_opts_t * opts;
+    ftw_engine                  * engine;
+    unsigned long long            config_signature;
+} ftw_daemon_ctx;
+
+int ftw_daemon_serve(const char * socket_path, ftw_daemon_handler_fn handler, void * ctx);
+int ftw_daemon_send(const char * socket_path, const char * request);
+int ftw_daemon_client(const char * socket_path, const char * req, const struct ftw_run_opts_t * opts);
+int ftw_daemon_handler(void * ctx, char * request);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwhistogram.c
+// histogram of durations with logarithmic buckets
+//
+// the values below 4 have their own buckets, the others are placed by
+// their highest bit and the next 2 bits
+//
+
+#include "ftwhistogram.h"
+
+static unsigned int histogram_bucket(unsigned long long value) {
+    unsigned int bit;
+
+    if (value < 4) {
+        return (unsigned int)value;
+    }
+    bit = 63 - __builtin_clzll(value);
+    return (bit - 1) * 4 + (unsigned int)((value >> (bit - 2)) & 3);
+}
+
+// the smallest value of a bucket
+static unsigned long long histogram_bucket_low(unsigned int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    return (4ULL + bucket % 4) << (bucket / 4 - 1);
+}
+
+void ftw_histogram_add(ftw_histogram * histogram, unsigned long long value) {
+    histogram->buckets[histogram_bucket(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+// the value below which the given percent of the values fall, estimated
+// by the middle of its bucket
+unsigned long long ftw_histogram_percentile(const ftw_histogram * histogram, double percent) {
+    unsigned long long rank = (unsigned long long)(histogram->count * percent / 100.0 + 0.5);
+    unsigned long long seen = 0;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (unsigned int b = 0; b < FTW_HISTOGRAM_BUCKETS; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= rank) {
+            unsigned long long low  = histogram_bucket_low(b);
+            unsigned long long high = (b + 1 < FTW_HISTOGRAM_BUCKETS) ? histogram_bucket_low(b + 1) : low;
+            unsigned long long mid  = low + (high - low) / 2;
+            return (mid < histogram->max) ? mid : histogram->max;
+        }
+    }
+    return histogram->max;
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwhistogram.h
+// histogram of durations with logarithmic buckets
+//
+
+#ifndef _FTWHISTOGRAM_H
+#define _FTWHISTOGRAM_H
+
+// 4 buckets for every power of 2, the error is less than 25%
+#define FTW_HISTOGRAM_BUCKETS 256
+
+typedef struct ftw_histogram_t {
+    unsigned long long   count;
+    unsigned long long   sum;
+    unsigned long long   max;
+    unsigned long long   buckets[FTW_HISTOGRAM_BUCKETS];
+} ftw_histogram;
+
+void               ftw_histogram_add(ftw_histogram * histogram, unsigned long long value);
+unsigned long long ftw_histogram_percentile(const ftw_histogram * histogram, double percent);
+
+#endif
@@ -0,0 +1,399 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwimpact.c
+// rule to test impact analysis
+//
+// the fired rules of the tests are stored in a text file, a line for
+// every test:
+//   <test> <id> <id> ...
+// a change can be a config file, a unified diff (eg. the output of
+// 'git diff') or the changes in the git repository of the config
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include "ftwimpact.h"
+
+static int uintcmp(const void *p1, const void *p2) {
+    unsigned int a = *(const unsigned int *)p1;
+    unsigned int b = *(const unsigned int *)p2;
+    return (a > b) - (a < b);
+}
+
+// add an id to a list if it's not there
+static void impact_add_id(unsigned int ** ids, unsigned int * ids_count, unsigned int id) {
+    for (unsigned int i = 0; i < *ids_count; i++) {
+        if ((*ids)[i] == id) {
+            return;
+        }
+    }
+    *ids = realloc(*ids, sizeof(unsigned int) * (*ids_count + 1));
+    if (*ids == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    (*ids)[(*ids_count)++] = id;
+}
+
+// find the position of a test, or the position where it should be inserted
+static unsigned int fired_db_position(const ftw_fired_db * db, const char * test, int * found) {
+    unsigned int first = 0;
+    unsigned int last  = db->count;
+
+    *found = 0;
+    while (first < last) {
+        unsigned int middle = (first + last) / 2;
+        int          cmp    = strcmp(db->tests[middle].test, test);
+        if (cmp == 0) {
+            *found = 1;
+            return middle;
+        }
+        if (cmp < 0) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+// open the fired rules database
+// a missing file is an empty database
+ftw_fired_db * ftw_fired_db_open(const char * path) {
+    ftw_fired_db * db = calloc(1, sizeof(ftw_fired_db));
+    FILE         * fp;
+    char         * line     = NULL;
+    size_t         linesize = 0;
+
+    if (db == NULL || (db->path = strdup(path)) == NULL) {
+        free(db);
+        return NULL;
+    }
+    if ((fp = fopen(path, "r")) == NULL) {
+        return db;
+    }
+    while (getline(&line, &linesize, fp) != -1) {
+        char         * saveptr = NULL;
+        char         * test    = strtok_r(line, " \t\n", &saveptr);
+        char         * tok;
+        unsigned int * ids       = NULL;
+        unsigned int   ids_count = 0;
+
+        if (test == NULL) {
+            continue;
+        }
+        while ((tok = strtok_r(NULL, " \t\n", &saveptr)) != NULL) {
+            impact_add_id(&ids, &ids_count, strtoul(tok, NULL, 10));
+        }
+        ftw_fired_db_add(db, test, ids, ids_count);
+        free(ids);
+    }
+    // the loaded records are not from this run
+    for (unsigned int i = 0; i < db->count; i++) {
+        db->tests[i].updated = 0;
+    }
+    free(line);
+    fclose(fp);
+    return db;
+}
+
+void ftw_fired_db_free(ftw_fired_db * db) {
+    if (db == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < db->count; i++) {
+        free(db->tests[i].test);
+        free(db->tests[i].ids);
+    }
+    free(db->tests);
+    free(db->path);
+    free(db);
+}
+
+// find the fired rules of a test
+// returns NULL if the test is not in the database
+const ftw_fired * ftw_fired_db_find(const ftw_fired_db * db, const char * test) {
+    int          found;
+    unsigned int pos = fired_db_position(db, test, &found);
+
+    return (found == 1) ? &db->tests[pos] : NULL;
+}
+
+// add the fired rules of a test (a stage of the test)
+// the first call in a run replaces the stored record, the next calls add
+// the rules of the other stages
+void ftw_fired_db_add(ftw_fired_db * db, const char * test, const unsigned int * ids, unsigned int ids_count) {
+    int          found;
+    unsigned int pos = fired_db_position(db, test, &found);
+    ftw_fired  * rec;
+
+    if (found == 0) {
+        db->tests = realloc(db->tests, sizeof(ftw_fired) * (db->count + 1));
+        if (db->tests == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        memmove(&db->tests[pos + 1], &db->tests[pos], sizeof(ftw_fired) * (db->count - pos));
+        memset(&db->tests[pos], 0, sizeof(ftw_fired));
+        db->tests[pos].test = strdup(test);
+        db->count++;
+    }
+    rec = &db->tests[pos];
+    if (rec->updated == 0) {
+        free(rec->ids);
+        rec->ids       = NULL;
+        rec->ids_count = 0;
+        rec->updated   = 1;
+    }
+    for (unsigned int i = 0; i < ids_count; i++) {
+        impact_add_id(&rec->ids, &rec->ids_count, ids[i]);
+    }
+    if (rec->ids_count > 0) {
+        qsort(rec->ids, rec->ids_count, sizeof(unsigned int), uintcmp);
+    }
+}
+
+// write the database
+// returns 0, or -1 on error
+int ftw_fired_db_save(const ftw_fired_db * db) {
+    char   tmppath[PATH_MAX];
+    FILE * fp;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", db->path);
+    if ((fp = fopen(tmppath, "w")) == NULL) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < db->count; i++) {
+        fprintf(fp, "%s", db->tests[i].test);
+        for (unsigned int r = 0; r < db->tests[i].ids_count; r++) {
+            fprintf(fp, " %u", db->tests[i].ids[r]);
+        }
+        fprintf(fp, "\n");
+    }
+    if (fclose(fp) != 0 || rename(tmppath, db->path) != 0) {
+        remove(tmppath);
+        return -1;
+    }
+    return 0;
+}
+
+// find a config file by the path of a diff, which is relative to the
+// root of the repository
+static int impact_find_file(const ftw_ruleindex * index, const char * path) {
+    size_t len = strlen(path);
+
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        size_t flen = strlen(index->files[i].path);
+        if (strcmp(index->files[i].path, path) == 0
+            || (flen > len && strcmp(index->files[i].path + flen - len, path) == 0 && index->files[i].path[flen - len - 1] == '/')) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// add the rules of a file, which overlap the changed lines
+// with line_start 0 every rule of the file is added
+// a change of a setup or an infrastructure file (eg. initialization,
+// blocking evaluation) can affect every test: their rules run for every
+// request, and they don't log
+static void impact_add_lines(const ftw_ruleindex * index, int fi, unsigned int line_start, unsigned int line_end, unsigned int ** ids, unsigned int * ids_count, int * all) {
+    for (unsigned int r = 0; r < index->rules_count; r++) {
+        const ftw_rule * rule = &index->rules[r];
+        if (rule->file == (unsigned int)fi && (line_start == 0 || (rule->line_start <= line_end && rule->line_end >= line_start))) {
+            impact_add_id(ids, ids_count, rule->id);
+        }
+    }
+    if (index->files[fi].includes > 0 || ftw_ruleindex_is_optional_file(index->files[fi].path) == 0) {
+        *all = 1;
+    }
+}
+
+// add the rule ids of a removed line, eg. the id action of a deleted rule
+// or the old id of a changed one; these rules aren't in the current config
+static void impact_add_removed_ids(const char * line, unsigned int ** ids, unsigned int * ids_count) {
+    for (const char * p = line; *p != '\0'; p++) {
+        // the action, not the end of an other name (eg. ruleRemoveById)
+        if (strncasecmp(p, "id:", 3) == 0 && (p == line || (isalnum((unsigned char)p[-1]) == 0 && p[-1] != '_' && p[-1] != '.'))) {
+            const char * v = p + 3;
+            while (*v == '\'' || isspace((unsigned char)*v)) {
+                v++;
+            }
+            if (isdigit((unsigned char)*v)) {
+                impact_add_id(ids, ids_count, strtoul(v, NULL, 10));
+            }
+        }
+    }
+}
+
+// read a unified diff, and collect the rules of the changed lines
+// the new side of a hunk is mapped onto the rules of the current files,
+// the removed lines of the old side are scanned for the ids of the rules,
+// which were deleted or got an other id
+static void impact_read_diff(const ftw_ruleindex * index, FILE * fp, unsigned int ** ids, unsigned int * ids_count, int * all) {
+    char   * line     = NULL;
+    size_t   linesize = 0;
+    int      fi       = -1;
+    int      removed  = 0;     // the removed lines of the file are scanned
+    unsigned int old_left = 0, new_left = 0;
+
+    while (getline(&line, &linesize, fp) != -1) {
+        unsigned int old_start, old_len = 1, new_start, new_len = 1;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        // the lines of a hunk, counted by the ranges of its header, so a
+        // removed line starting with "-- " isn't taken for a file header
+        if (old_left > 0 || new_left > 0) {
+            if (line[0] == '-' && old_left > 0) {
+                old_left--;
+                if (removed == 1) {
+                    impact_add_removed_ids(line + 1, ids, ids_count);
+                }
+            }
+            else if (line[0] == '+' && new_left > 0) {
+                new_left--;
+            }
+            else if (line[0] == ' ' || line[0] == '\0') {
+                old_left -= (old_left > 0);
+                new_left -= (new_left > 0);
+            }
+            else if (line[0] != '\\') {
+                // "\ No newline at end of file" is not a line of the hunk
+                old_left = new_left = 0;
+            }
+            if (old_left > 0 || new_left > 0) {
+                continue;
+            }
+        }
+        if (strncmp(line, "--- ", 4) == 0) {
+            char * path = line + 4;
+            size_t len;
+            path[strcspn(path, "\t")] = '\0';
+            // the rules of a config file, or of a deleted one; the "+++"
+            // line clears it if the file is not part of the config
+            len     = strlen(path);
+            removed = (len > 5 && strcmp(path + len - 5, ".conf") == 0);
+        }
+        else if (strncmp(line, "+++ ", 4) == 0) {
+            char * path = line + 4;
+            // diff -u appends the timestamp after a tab
+            path[strcspn(path, "\t")] = '\0';
+            if (strncmp(path, "b/", 2) == 0) {
+                path += 2;
+            }
+            fi = (strcmp(path, "/dev/null") == 0) ? -1 : impact_find_file(index, path);
+            if (fi < 0 && strcmp(path, "/dev/null") != 0) {
+                fprintf(stderr, "Note: %s is not part of the config\n", path);
+                removed = 0;
+            }
+            else if (fi >= 0) {
+                removed = 1;
+            }
+        }
+        else if (strncmp(line, "@@ ", 3) == 0) {
+            if (sscanf(line, "@@ -%u,%u +%u,%u @@", &old_start, &old_len, &new_start, &new_len) != 4) {
+                old_len = 1;
+                new_len = 1;
+                if (sscanf(line, "@@ -%u +%u,%u @@", &old_start, &new_start, &new_len) != 3
+                    && sscanf(line, "@@ -%u,%u +%u @@", &old_start, &old_len, &new_start) != 3
+                    && sscanf(line, "@@ -%u +%u @@", &old_start, &new_start) != 2) {
+                    continue;
+                }
+            }
+            old_left = old_len;
+            new_left = new_len;
+            if (fi >= 0) {
+                // a removal is between new_start and new_start + 1
+                impact_add_lines(index, fi, (new_start > 0) ? new_start : 1, new_start + ((new_len > 0) ? new_len - 1 : 1), ids, ids_count, all);
+            }
+        }
+    }
+    free(line);
+}
+
+// collect the rules affected by a change:
+// - a config file: every rule of the file
+// - a unified diff file: the rules of the changed lines
+// - "git" or "git:REV": the changes of the git repository of the config
+//   since HEAD or REV
+// *all is set to 1 if the change can affect every test, eg. a changed
+// setup file
+// returns 0, or -1 if the change can't be read
+int ftw_impact_changed_ids(const ftw_ruleindex * index, const char * change, const char * main_rule_uri, unsigned int ** ids, unsigned int * ids_count, int * all) {
+    char   resolved[PATH_MAX];
+    FILE * fp;
+
+    *all = 0;
+    if (strcmp(change, "git") == 0 || strncmp(change, "git:", 4) == 0) {
+        char   cmd[PATH_MAX * 2];
+        char * dircopy = strdup(main_rule_uri);
+        const char * rev = (change[3] == ':') ? change + 4 : "HEAD";
+
+        if (dircopy == NULL || strchr(rev, '\'') != NULL) {
+            free(dircopy);
+            return -1;
+        }
+        snprintf(cmd, sizeof(cmd), "git -C '%s' diff -U0 '%s' -- 2>/dev/null", dirname(dircopy), rev);
+        free(dircopy);
+        if ((fp = popen(cmd, "r")) == NULL) {
+            return -1;
+        }
+        impact_read_diff(index, fp, ids, ids_count, all);
+        return (pclose(fp) == 0) ? 0 : -1;
+    }
+    if (realpath(change, resolved) != NULL) {
+        int fi = ftw_ruleindex_find_file(index, resolved);
+        if (fi >= 0) {
+            impact_add_lines(index, fi, 0, 0, ids, ids_count, all);
+            return 0;
+        }
+    }
+    if ((fp = fopen(change, "r")) == NULL) {
+        return -1;
+    }
+    impact_read_diff(index, fp, ids, ids_count, all);
+    fclose(fp);
+    return 0;
+}
+
+// check whether a test is affected by the changed rules: the test belongs
+// to a changed rule, or a changed rule fired in the previous run of the
+// test
+// the tests without record are affected
+int ftw_impact_test_affected(const ftw_fired_db * db, const char * test, unsigned int rule_id, const unsigned int * ids, unsigned int ids_count) {
+    const ftw_fired * rec = (db != NULL) ? ftw_fired_db_find(db, test) : NULL;
+
+    if (rec == NULL) {
+        return 1;
+    }
+    for (unsigned int i = 0; i < ids_count; i++) {
+        if (ids[i] == rule_id || bsearch(&ids[i], rec->ids, rec->ids_count, sizeof(unsigned int), uintcmp) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
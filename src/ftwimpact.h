@@ -0,0 +1,53 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwimpact.h
+// rule to test impact analysis: the fired rules of the tests, and the
+// rules affected by a change
+//
+
+#ifndef _FTWIMPACT_H
+#define _FTWIMPACT_H
+
+#include "ruleindex.h"
+
+#define FTWRUNNER_FIRED ".ftwrunner.fired"
+
+typedef struct ftw_fired_t {
+    char          * test;       // eg. 920100-1
+    unsigned int  * ids;        // sorted
+    unsigned int    ids_count;
+    int             updated;    // the test ran in this run
+} ftw_fired;
+
+typedef struct ftw_fired_db_t {
+    char          * path;
+    ftw_fired     * tests;      // sorted by test
+    unsigned int    count;
+} ftw_fired_db;
+
+ftw_fired_db    * ftw_fired_db_open(const char * path);
+void              ftw_fired_db_free(ftw_fired_db * db);
+const ftw_fired * ftw_fired_db_find(const ftw_fired_db * db, const char * test);
+void              ftw_fired_db_add(ftw_fired_db * db, const char * test, const unsigned int * ids, unsigned int ids_count);
+int               ftw_fired_db_save(const ftw_fired_db * db);
+
+int               ftw_impact_changed_ids(const ftw_ruleindex * index, const char * change, const char * main_rule_uri, unsigned int ** ids, unsigned int * ids_count, int * all);
+int               ftw_impact_test_affected(const ftw_fired_db * db, const char * test, unsigned int rule_id, const unsigned int * ids, unsigned int ids_count);
+
+#endif
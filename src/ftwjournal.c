@@ -0,0 +1,167 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwjournal.c
+// append-only journal of the results of a run
+//
+// the file has a header line with the hash of the run (config, test root,
+// engine, selection and options), a line for every stage, which is
+// flushed immediately:
+//   <test> <stage> <result> <duration in ns> [<phase durations in ns>...]
+// the phases are the ones of the engine (connection, uri, request headers
+// and body, response headers and body, logging, log check), they are
+// missing if the stage wasn't run by the engine
+// and an 'END' line if the run wasn't interrupted
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftwjournal.h"
+
+static int journal_entrycmp(const void *p1, const void *p2) {
+    const ftw_journal_entry * a = p1;
+    const ftw_journal_entry * b = p2;
+    int                       cmp = strcmp(a->test, b->test);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (a->stage > b->stage) - (a->stage < b->stage);
+}
+
+// load the results of the previous run, if it was the same run
+// a missing file or another run gives an empty journal
+// returns NULL on memory allocation error
+ftw_journal * ftw_journal_load(const char * path, unsigned long long run) {
+    ftw_journal * journal = calloc(1, sizeof(ftw_journal));
+    FILE        * fp;
+
+    if (journal == NULL) {
+        return NULL;
+    }
+    journal->path = strdup(path);
+    journal->run  = run;
+    if (journal->path == NULL) {
+        ftw_journal_free(journal);
+        return NULL;
+    }
+
+    if ((fp = fopen(path, "r")) != NULL) {
+        char               line[512];
+        unsigned long long file_run = 0;
+
+        if (fgets(line, sizeof(line), fp) != NULL
+            && strncmp(line, FTW_JOURNAL_MAGIC " ", strlen(FTW_JOURNAL_MAGIC) + 1) == 0
+            && sscanf(line + strlen(FTW_JOURNAL_MAGIC) + 1, "%llx", &file_run) == 1
+            && file_run == run) {
+            while (fgets(line, sizeof(line), fp) != NULL) {
+                ftw_journal_entry   entry;
+                char                test[128];
+
+                journal->partial = (strchr(line, '\n') == NULL) ? 1 : 0;
+                if (strcmp(line, "END\n") == 0) {
+                    journal->complete = 1;
+                }
+                // an interrupted write leaves a partial line without newline
+                else if (strchr(line, '\n') != NULL
+                    && sscanf(line, "%127s %u %d %llu", test, &entry.stage, &entry.result, &entry.duration_ns) == 4) {
+                    ftw_journal_entry * entries = realloc(journal->entries, sizeof(ftw_journal_entry) * (journal->count + 1));
+                    if (entries == NULL || (entry.test = strdup(test)) == NULL) {
+                        journal->entries = (entries != NULL) ? entries : journal->entries;
+                        fclose(fp);
+                        ftw_journal_free(journal);
+                        return NULL;
+                    }
+                    journal->entries = entries;
+                    journal->entries[journal->count++] = entry;
+                }
+            }
+        }
+        fclose(fp);
+    }
+    qsort(journal->entries, journal->count, sizeof(ftw_journal_entry), journal_entrycmp);
+    return journal;
+}
+
+void ftw_journal_free(ftw_journal * journal) {
+    if (journal != NULL) {
+        if (journal->fp != NULL) {
+            fclose(journal->fp);
+        }
+        for (unsigned int i = 0; i < journal->count; i++) {
+            free(journal->entries[i].test);
+        }
+        free(journal->entries);
+        free(journal->path);
+        free(journal);
+    }
+}
+
+// open the journal for writing
+// with append the results of the previous run are kept, otherwise the
+// journal is started again
+// returns 0, or -1 on error
+int ftw_journal_open(ftw_journal * journal, int append) {
+    if (append == 1 && journal->count > 0) {
+        journal->fp = fopen(journal->path, "a");
+        if (journal->fp != NULL && journal->partial == 1) {
+            fputc('\n', journal->fp);
+        }
+    }
+    else {
+        journal->fp = fopen(journal->path, "w");
+        if (journal->fp != NULL) {
+            fprintf(journal->fp, "%s %016llx\n", FTW_JOURNAL_MAGIC, journal->run);
+            fflush(journal->fp);
+        }
+    }
+    return (journal->fp != NULL) ? 0 : -1;
+}
+
+// find the result of a stage in the previous run
+const ftw_journal_entry * ftw_journal_find(const ftw_journal * journal, const char * test, unsigned int stage) {
+    ftw_journal_entry key;
+
+    key.test  = (char *)test;
+    key.stage = stage;
+    return bsearch(&key, journal->entries, journal->count, sizeof(ftw_journal_entry), journal_entrycmp);
+}
+
+// write the result of a stage, and flush it
+void ftw_journal_append(ftw_journal * journal, const char * test, unsigned int stage, int result, unsigned long long duration_ns,
+                        const unsigned long long * phases_ns, unsigned int phases_count) {
+    if (journal->fp != NULL) {
+        fprintf(journal->fp, "%s %u %d %llu", test, stage, result, duration_ns);
+        for (unsigned int i = 0; i < phases_count; i++) {
+            fprintf(journal->fp, " %llu", phases_ns[i]);
+        }
+        fprintf(journal->fp, "\n");
+        fflush(journal->fp);
+    }
+}
+
+// mark the run as complete, and close the journal
+void ftw_journal_finish(ftw_journal * journal) {
+    if (journal->fp != NULL) {
+        fprintf(journal->fp, "END\n");
+        fclose(journal->fp);
+        journal->fp = NULL;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwjournal.h
+// append-only journal of the results of a run, for '--resume' and
+// '--rerun-failed'
+//
+
+#ifndef _FTWJOURNAL_H
+#define _FTWJOURNAL_H
+
+#include <stdio.h>
+
+#define FTWRUNNER_JOURNAL ".ftwrunner.journal"
+
+#define FTW_JOURNAL_MAGIC "ftwrunner-journal 1"
+
+typedef struct ftw_journal_entry_t {
+    char               * test;         // eg. 920100-1
+    unsigned int         stage;
+    int                  result;
+    unsigned long long   duration_ns;
+} ftw_journal_entry;
+
+typedef struct ftw_journal_t {
+    char               * path;
+    unsigned long long   run;          // hash of the config, the selection and the options
+    FILE               * fp;
+    ftw_journal_entry  * entries;      // the results of the previous run, sorted by test and stage
+    unsigned int         count;
+    int                  complete;     // the previous run wasn't interrupted
+    int                  partial;      // the last line was interrupted
+} ftw_journal;
+
+ftw_journal             * ftw_journal_load(const char * path, unsigned long long run);
+void                      ftw_journal_free(ftw_journal * journal);
+int                       ftw_journal_open(ftw_journal * journal, int append);
+const ftw_journal_entry * ftw_journal_find(const ftw_journal * journal, const char * test, unsigned int stage);
+void                      ftw_journal_append(ftw_journal * journal, const char * test, unsigned int stage, int result, unsigned long long duration_ns,
+                                             const unsigned long long * phases_ns, unsigned int phases_count);
+void                      ftw_journal_finish(ftw_journal * journal);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwlatency.c
+// report of the slowest tests and rules
+//
+// the transaction time of every stage run by the engine is recorded; the
+// tests are ranked by the sum of their stages, the rules by the sum and
+// by the 99th percentile of the stages of their tests
+// the payload shows whether a slow test has a big input
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftwlatency.h"
+
+typedef struct ftw_latency_rule_t {
+    unsigned int         rule_id;
+    unsigned int         tests;
+    unsigned int         stages;
+    unsigned long        payload;
+    unsigned long long   total_ns;
+    unsigned long long   p99_ns;
+} ftw_latency_rule;
+
+// the slowest first
+static int latency_test_cmp(const void *p1, const void *p2) {
+    const ftw_latency_test * a = *(ftw_latency_test * const *)p1;
+    const ftw_latency_test * b = *(ftw_latency_test * const *)p2;
+    return (a->time_ns < b->time_ns) - (a->time_ns > b->time_ns);
+}
+
+static int latency_rule_total_cmp(const void *p1, const void *p2) {
+    const ftw_latency_rule * a = p1;
+    const ftw_latency_rule * b = p2;
+    return (a->total_ns < b->total_ns) - (a->total_ns > b->total_ns);
+}
+
+static int latency_rule_p99_cmp(const void *p1, const void *p2) {
+    const ftw_latency_rule * a = p1;
+    const ftw_latency_rule * b = p2;
+    return (a->p99_ns < b->p99_ns) - (a->p99_ns > b->p99_ns);
+}
+
+// order the stages by rule and time
+static int latency_stage_cmp(const void *p1, const void *p2) {
+    const ftw_latency_stage * a = p1;
+    const ftw_latency_stage * b = p2;
+
+    if (a->rule_id != b->rule_id) {
+        return (a->rule_id > b->rule_id) ? 1 : -1;
+    }
+    return (a->time_ns > b->time_ns) - (a->time_ns < b->time_ns);
+}
+
+// add a timed stage of a test
+// the stages of a test are added after each other
+void ftw_latency_add(ftw_latency * latency, const char * test, unsigned int rule_id, unsigned long payload, unsigned long long time_ns) {
+    ftw_latency_test * rec = (latency->count > 0) ? &latency->tests[latency->count - 1] : NULL;
+
+    if (rec == NULL || strcmp(rec->test, test) != 0) {
+        if (latency->count == latency->allocated) {
+            unsigned int       allocated = (latency->allocated == 0) ? 256 : latency->allocated * 2;
+            ftw_latency_test * tests     = realloc(latency->tests, sizeof(ftw_latency_test) * allocated);
+            if (tests == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            latency->tests     = tests;
+            latency->allocated = allocated;
+        }
+        rec = &latency->tests[latency->count++];
+        memset(rec, 0, sizeof(ftw_latency_test));
+        snprintf(rec->test, sizeof(rec->test), "%s", test);
+        rec->rule_id = rule_id;
+    }
+    rec->stages++;
+    rec->payload += payload;
+    rec->time_ns += time_ns;
+
+    if (latency->stages_count == latency->stages_allocated) {
+        unsigned int        allocated = (latency->stages_allocated == 0) ? 256 : latency->stages_allocated * 2;
+        ftw_latency_stage * stages    = realloc(latency->stages, sizeof(ftw_latency_stage) * allocated);
+        if (stages == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        latency->stages           = stages;
+        latency->stages_allocated = allocated;
+    }
+    latency->stages[latency->stages_count].rule_id = rule_id;
+    latency->stages[latency->stages_count].time_ns = time_ns;
+    latency->stages_count++;
+}
+
+// the rules of the timed stages
+static ftw_latency_rule * latency_rules(const ftw_latency * latency, unsigned int * count) {
+    ftw_latency_stage * stages = malloc(sizeof(ftw_latency_stage) * (latency->stages_count + 1));
+    ftw_latency_rule  * rules  = calloc(latency->stages_count + 1, sizeof(ftw_latency_rule));
+    unsigned int        first  = 0;
+
+    *count = 0;
+    if (stages == NULL || rules == NULL) {
+        free(stages);
+        free(rules);
+        return NULL;
+    }
+    memcpy(stages, latency->stages, sizeof(ftw_latency_stage) * latency->stages_count);
+    qsort(stages, latency->stages_count, sizeof(ftw_latency_stage), latency_stage_cmp);
+    while (first < latency->stages_count) {
+        ftw_latency_rule * rule = &rules[(*count)++];
+        unsigned int       last = first;
+
+        rule->rule_id = stages[first].rule_id;
+        while (last < latency->stages_count && stages[last].rule_id == rule->rule_id) {
+            rule->total_ns += stages[last].time_ns;
+            rule->stages++;
+            last++;
+        }
+        for (unsigned int t = 0; t < latency->count; t++) {
+            if (latency->tests[t].rule_id == rule->rule_id) {
+                rule->tests++;
+                rule->payload += latency->tests[t].payload;
+            }
+        }
+        // nearest rank
+        rule->p99_ns = stages[first + (rule->stages * 99 + 99) / 100 - 1].time_ns;
+        first = last;
+    }
+    free(stages);
+    return rules;
+}
+
+// show the slowest tests, and the slowest rules by the total and by the
+// 99th percentile of their stages
+void ftw_latency_show(const ftw_latency * latency, unsigned int top) {
+    const ftw_latency_test ** tests = malloc(sizeof(ftw_latency_test *) * (latency->count + 1));
+    ftw_latency_rule        * rules;
+    unsigned int              rules_count;
+
+    if (tests == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < latency->count; i++) {
+        tests[i] = &latency->tests[i];
+    }
+    qsort(tests, latency->count, sizeof(ftw_latency_test *), latency_test_cmp);
+    printf("SLOWEST TESTS           time (ms)  stages  payload (bytes)\n");
+    for (unsigned int i = 0; i < latency->count && i < top; i++) {
+        printf("%-23s %9.3f %7u %8lu\n", tests[i]->test, tests[i]->time_ns / 1000000.0, tests[i]->stages, tests[i]->payload);
+    }
+    printf("===============================\n");
+    free(tests);
+
+    if ((rules = latency_rules(latency, &rules_count)) == NULL) {
+        return;
+    }
+    qsort(rules, rules_count, sizeof(ftw_latency_rule), latency_rule_total_cmp);
+    printf("SLOWEST RULES (TOTAL)  total (ms)  p99 (ms)  tests  stages  avg payload (bytes)\n");
+    for (unsigned int i = 0; i < rules_count && i < top; i++) {
+        printf("%-23u %9.3f %9.3f %6u %7u %8lu\n", rules[i].rule_id, rules[i].total_ns / 1000000.0, rules[i].p99_ns / 1000000.0,
+            rules[i].tests, rules[i].stages, rules[i].payload / rules[i].stages);
+    }
+    printf("===============================\n");
+    qsort(rules, rules_count, sizeof(ftw_latency_rule), latency_rule_p99_cmp);
+    printf("SLOWEST RULES (P99)    total (ms)  p99 (ms)  tests  stages  avg payload (bytes)\n");
+    for (unsigned int i = 0; i < rules_count && i < top; i++) {
+        printf("%-23u %9.3f %9.3f %6u %7u %8lu\n", rules[i].rule_id, rules[i].total_ns / 1000000.0, rules[i].p99_ns / 1000000.0,
+            rules[i].tests, rules[i].stages, rules[i].payload / rules[i].stages);
+    }
+    printf("===============================\n");
+    free(rules);
+}
+
+void ftw_latency_free(ftw_latency * latency) {
+    if (latency != NULL) {
+        free(latency->tests);
+        free(latency->stages);
+        free(latency);
+    }
+}
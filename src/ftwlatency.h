@@ -0,0 +1,53 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwlatency.h
+// report of the slowest tests and rules
+//
+
+#ifndef _FTWLATENCY_H
+#define _FTWLATENCY_H
+
+typedef struct ftw_latency_test_t {
+    char                 test[50];
+    unsigned int         rule_id;
+    unsigned int         stages;
+    unsigned long        payload;      // bytes of the requests of the timed stages
+    unsigned long long   time_ns;      // the transactions of the stages
+} ftw_latency_test;
+
+// a timed stage
+typedef struct ftw_latency_stage_t {
+    unsigned int         rule_id;      // of the test, the stages are ordered by it
+    unsigned long long   time_ns;
+} ftw_latency_stage;
+
+typedef struct ftw_latency_t {
+    ftw_latency_test   * tests;
+    unsigned int         count;
+    unsigned int         allocated;
+    ftw_latency_stage  * stages;
+    unsigned int         stages_count;
+    unsigned int         stages_allocated;
+} ftw_latency;
+
+void ftw_latency_add(ftw_latency * latency, const char * test, unsigned int rule_id, unsigned long payload, unsigned long long time_ns);
+void ftw_latency_show(const ftw_latency * latency, unsigned int top);
+void ftw_latency_free(ftw_latency * latency);
+
+#endif
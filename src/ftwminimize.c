@@ -0,0 +1,188 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwminimize.c
+// minimal subset of the tests with the same rule coverage
+//
+// the rules fired by the tests of a run are mapped to bit positions,
+// every test gets a bitset of its fired rules (the union of its stages),
+// and a greedy set cover chooses the test with the most uncovered rules
+// until every fired rule is covered
+// the subset is written as a selection file for '-s @file'
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ftwminimize.h"
+
+typedef unsigned long long ftw_bitword;
+
+#define FTW_BITWORD_BITS (sizeof(ftw_bitword) * 8)
+
+static int uintcmp(const void *p1, const void *p2) {
+    unsigned int a = *(const unsigned int *)p1;
+    unsigned int b = *(const unsigned int *)p2;
+    return (a > b) - (a < b);
+}
+
+// the position of a rule id in the sorted ids
+static unsigned int minimize_bit(const unsigned int * ids, unsigned int ids_count, unsigned int id) {
+    const unsigned int * found = bsearch(&id, ids, ids_count, sizeof(unsigned int), uintcmp);
+    return (unsigned int)(found - ids);
+}
+
+// number of the bits of a test, which are not covered yet
+static unsigned int minimize_gain(const ftw_bitword * bits, const ftw_bitword * covered, unsigned int words) {
+    unsigned int gain = 0;
+
+    for (unsigned int w = 0; w < words; w++) {
+        gain += __builtin_popcountll(bits[w] & ~covered[w]);
+    }
+    return gain;
+}
+
+// choose the tests of the run (the updated records of the fired rules
+// database), which fire every rule fired by the run
+// returns NULL on memory allocation error
+ftw_minimal * ftw_minimize(const ftw_fired_db * db) {
+    ftw_minimal   * minimal   = calloc(1, sizeof(ftw_minimal));
+    unsigned int  * ids       = NULL;
+    unsigned int    ids_count = 0;
+    const ftw_fired ** tests  = calloc(db->count + 1, sizeof(ftw_fired *));
+    unsigned int    count     = 0;
+    unsigned int    words;
+    ftw_bitword   * bits      = NULL;
+    ftw_bitword   * covered   = NULL;
+    unsigned int    uncovered;
+
+    if (minimal == NULL || tests == NULL) {
+        free(minimal);
+        free(tests);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < db->count; i++) {
+        if (db->tests[i].updated == 1) {
+            tests[count++] = &db->tests[i];
+            ids_count     += db->tests[i].ids_count;
+        }
+    }
+    minimal->candidates = count;
+
+    // the distinct fired rules
+    if ((ids = calloc(ids_count + 1, sizeof(unsigned int))) == NULL) {
+        free(minimal);
+        free(tests);
+        return NULL;
+    }
+    ids_count = 0;
+    for (unsigned int t = 0; t < count; t++) {
+        memcpy(&ids[ids_count], tests[t]->ids, sizeof(unsigned int) * tests[t]->ids_count);
+        ids_count += tests[t]->ids_count;
+    }
+    qsort(ids, ids_count, sizeof(unsigned int), uintcmp);
+    uncovered = 0;
+    for (unsigned int i = 0; i < ids_count; i++) {
+        if (uncovered == 0 || ids[uncovered - 1] != ids[i]) {
+            ids[uncovered++] = ids[i];
+        }
+    }
+    ids_count          = uncovered;
+    minimal->ids_count = ids_count;
+
+    words   = (ids_count + FTW_BITWORD_BITS - 1) / FTW_BITWORD_BITS + 1;
+    bits    = calloc((size_t)words * (count + 1), sizeof(ftw_bitword));
+    covered = calloc(words, sizeof(ftw_bitword));
+    if (bits == NULL || covered == NULL) {
+        free(bits);
+        free(covered);
+        free(ids);
+        free(tests);
+        free(minimal);
+        return NULL;
+    }
+    for (unsigned int t = 0; t < count; t++) {
+        for (unsigned int i = 0; i < tests[t]->ids_count; i++) {
+            unsigned int bit = minimize_bit(ids, ids_count, tests[t]->ids[i]);
+            bits[t * words + bit / FTW_BITWORD_BITS] |= 1ULL << (bit % FTW_BITWORD_BITS);
+        }
+    }
+
+    // greedy set cover, the first test wins on equal gains
+    while (uncovered > 0) {
+        unsigned int best      = 0;
+        unsigned int best_gain = 0;
+        char      ** list;
+
+        for (unsigned int t = 0; t < count; t++) {
+            unsigned int gain = minimize_gain(&bits[t * words], covered, words);
+            if (gain > best_gain) {
+                best      = t;
+                best_gain = gain;
+            }
+        }
+        if (best_gain == 0 || (list = realloc(minimal->tests, sizeof(char *) * (minimal->count + 1))) == NULL) {
+            break;
+        }
+        minimal->tests = list;
+        minimal->tests[minimal->count++] = strdup(tests[best]->test);
+        for (unsigned int w = 0; w < words; w++) {
+            covered[w] |= bits[best * words + w];
+        }
+        uncovered -= best_gain;
+    }
+
+    free(bits);
+    free(covered);
+    free(ids);
+    free(tests);
+    return minimal;
+}
+
+void ftw_minimal_free(ftw_minimal * minimal) {
+    if (minimal != NULL) {
+        for (unsigned int i = 0; i < minimal->count; i++) {
+            free(minimal->tests[i]);
+        }
+        free(minimal->tests);
+        free(minimal);
+    }
+}
+
+// write the subset as a selection file, a test in a line
+// returns 0, or -1 on error
+int ftw_minimal_write(const ftw_minimal * minimal, const char * path) {
+    char   tmppath[PATH_MAX];
+    FILE * fp;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    if ((fp = fopen(tmppath, "w")) == NULL) {
+        return -1;
+    }
+    fprintf(fp, "# %u of %u tests, which fire the same %u rules\n", minimal->count, minimal->candidates, minimal->ids_count);
+    for (unsigned int i = 0; i < minimal->count; i++) {
+        fprintf(fp, "%s\n", minimal->tests[i]);
+    }
+    if (fclose(fp) != 0 || rename(tmppath, path) != 0) {
+        remove(tmppath);
+        return -1;
+    }
+    return 0;
+}
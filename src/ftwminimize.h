@@ -0,0 +1,41 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwminimize.h
+// minimal subset of the tests with the same rule coverage
+//
+
+#ifndef _FTWMINIMIZE_H
+#define _FTWMINIMIZE_H
+
+#include "ftwimpact.h"
+
+#define FTWRUNNER_MINIMAL ".ftwrunner.minimal"
+
+typedef struct ftw_minimal_t {
+    char         ** tests;         // the chosen tests in the order of the choice
+    unsigned int    count;
+    unsigned int    candidates;    // number of the tests of the run
+    unsigned int    ids_count;     // number of the fired rules
+} ftw_minimal;
+
+ftw_minimal * ftw_minimize(const ftw_fired_db * db);
+void          ftw_minimal_free(ftw_minimal * minimal);
+int           ftw_minimal_write(const ftw_minimal * minimal, const char * path);
+
+#endif
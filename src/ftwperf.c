@@ -0,0 +1,300 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwperf.c
+// performance counters of the transactions (perf_event_open)
+//
+// the counters of the thread are opened in one group, so a read of the
+// leader returns all of them in one system call
+// the hardware counters aren't available in most of the containers and
+// virtual machines; then the software counters are used, the task clock
+// is the most stable of them
+// only the user space is counted, so a 'perf_event_paranoid' of 2 is enough
+// if the kernel multiplexes the hardware counters, the group runs only a
+// part of the time; the counts of a phase are scaled up by the enabled and
+// the running time, and the report marks them
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "ftwperf.h"
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const struct {
+    unsigned int         type;
+    unsigned long long   config;
+} perf_events[FTW_PERF_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+};
+
+// open the counters of the calling thread
+// returns NULL if none of them can be opened
+ftw_perf * ftw_perf_open(void) {
+    ftw_perf * perf = calloc(1, sizeof(ftw_perf));
+    int        leader = -1;
+
+    if (perf == NULL) {
+        return NULL;
+    }
+    for (int e = 0; e < FTW_PERF_COUNT; e++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = perf_events[e].type;
+        attr.config         = perf_events[e].config;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        perf->fd[e]       = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        perf->position[e] = -1;
+        if (perf->fd[e] < 0) {
+            perf->fd[e] = -1;
+            continue;
+        }
+        if (leader < 0) {
+            leader = perf->fd[e];
+        }
+        perf->position[e] = perf->count++;
+        if (perf_events[e].type == PERF_TYPE_HARDWARE) {
+            perf->hardware = 1;
+        }
+    }
+    if (perf->count == 0) {
+        free(perf);
+        return NULL;
+    }
+    return perf;
+}
+
+// read the counters, the not available ones are 0
+// the buffer is: nr, time enabled, time running, the values of the group
+int ftw_perf_read(const ftw_perf * perf, ftw_perf_values * values) {
+    unsigned long long buf[FTW_PERF_COUNT + 3];
+    int                leader = -1;
+
+    memset(values, 0, sizeof(ftw_perf_values));
+    for (int e = 0; e < FTW_PERF_COUNT && leader < 0; e++) {
+        leader = perf->fd[e];
+    }
+    if (read(leader, buf, sizeof(unsigned long long) * (perf->count + 3)) <= 0) {
+        return -1;
+    }
+    values->time_enabled = buf[1];
+    values->time_running = buf[2];
+    for (int e = 0; e < FTW_PERF_COUNT; e++) {
+        if (perf->position[e] >= 0 && (unsigned long long)perf->position[e] < buf[0]) {
+            values->value[e] = buf[perf->position[e] + 3];
+        }
+    }
+    return 0;
+}
+
+void ftw_perf_close(ftw_perf * perf) {
+    if (perf != NULL) {
+        for (int e = 0; e < FTW_PERF_COUNT; e++) {
+            if (perf->fd[e] >= 0) {
+                close(perf->fd[e]);
+            }
+        }
+        free(perf);
+    }
+}
+
+#else
+
+ftw_perf * ftw_perf_open(void) {
+    return NULL;
+}
+
+int ftw_perf_read(const ftw_perf * perf, ftw_perf_values * values) {
+    memset(values, 0, sizeof(ftw_perf_values));
+    return -1;
+}
+
+void ftw_perf_close(ftw_perf * perf) {
+    free(perf);
+}
+
+#endif
+
+// add the counts between two reads, scaled if the group didn't run all the
+// time between them
+void ftw_perf_add(ftw_perf_values * sum, const ftw_perf_values * from, const ftw_perf_values * to) {
+    unsigned long long enabled = to->time_enabled - from->time_enabled;
+    unsigned long long running = to->time_running - from->time_running;
+
+    for (int e = 0; e < FTW_PERF_COUNT; e++) {
+        unsigned long long count = to->value[e] - from->value[e];
+        if (running > 0 && running < enabled) {
+            count = (unsigned long long)((double)count * enabled / running);
+        }
+        sum->value[e] += count;
+    }
+    sum->time_enabled += to->time_enabled - from->time_enabled;
+    sum->time_running += to->time_running - from->time_running;
+}
+
+// add the counts of a stage of a test
+// the stages of a test are added after each other
+void ftw_perf_report_add(ftw_perf_report * report, const char * test, unsigned int rule_id, const ftw_perf_values * counts) {
+    ftw_perf_test * rec = (report->count > 0) ? &report->tests[report->count - 1] : NULL;
+
+    if (rec == NULL || strcmp(rec->test, test) != 0) {
+        if (report->count == report->allocated) {
+            unsigned int    allocated = (report->allocated == 0) ? 256 : report->allocated * 2;
+            ftw_perf_test * tests     = realloc(report->tests, sizeof(ftw_perf_test) * allocated);
+            if (tests == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            report->tests     = tests;
+            report->allocated = allocated;
+        }
+        rec = &report->tests[report->count++];
+        memset(rec, 0, sizeof(ftw_perf_test));
+        snprintf(rec->test, sizeof(rec->test), "%s", test);
+        rec->rule_id = rule_id;
+    }
+    for (int e = 0; e < FTW_PERF_COUNT; e++) {
+        rec->counts.value[e] += counts->value[e];
+    }
+    rec->counts.time_enabled += counts->time_enabled;
+    rec->counts.time_running += counts->time_running;
+}
+
+static const char * perf_names[FTW_PERF_COUNT] = {
+    "instructions", "cycles", "cache-miss", "branch-miss", "page-faults", "task-clock", "ctx-switch"
+};
+
+// the most counts first
+#define PERF_CMP_DESC(a, b, e) (((a)->counts.value[e] < (b)->counts.value[e]) - ((a)->counts.value[e] > (b)->counts.value[e]))
+
+static int perf_instructions_cmp(const void *p1, const void *p2) {
+    return PERF_CMP_DESC((const ftw_perf_test *)p1, (const ftw_perf_test *)p2, FTW_PERF_INSTRUCTIONS);
+}
+
+static int perf_task_clock_cmp(const void *p1, const void *p2) {
+    return PERF_CMP_DESC((const ftw_perf_test *)p1, (const ftw_perf_test *)p2, FTW_PERF_TASK_CLOCK);
+}
+
+static int perf_rule_cmp(const void *p1, const void *p2) {
+    const ftw_perf_test * a = p1;
+    const ftw_perf_test * b = p2;
+    return (a->rule_id > b->rule_id) - (a->rule_id < b->rule_id);
+}
+
+static void perf_header(const ftw_perf * perf, const char * title) {
+    printf("%-23s", title);
+    for (int e = 0; e < FTW_PERF_COUNT; e++) {
+        if (perf->fd[e] >= 0) {
+            printf(" %13s", perf_names[e]);
+        }
+    }
+    printf("\n");
+}
+
+static void perf_show(const ftw_perf * perf, const ftw_perf_test * tests, unsigned int count, unsigned int top, int rules) {
+    for (unsigned int i = 0; i < count && i < top; i++) {
+        char name[50];
+        if (rules == 1) {
+            snprintf(name, sizeof(name), "%u", tests[i].rule_id);
+        }
+        printf("%-23s", (rules == 1) ? name : tests[i].test);
+        for (int e = 0; e < FTW_PERF_COUNT; e++) {
+            if (perf->fd[e] >= 0) {
+                printf(" %13llu", tests[i].counts.value[e]);
+            }
+        }
+        if (tests[i].counts.time_running < tests[i].counts.time_enabled) {
+            // multiplexed, the counts are estimates
+            printf(" (scaled, %.0f%% counted)", 100.0 * tests[i].counts.time_running / tests[i].counts.time_enabled);
+        }
+        printf("\n");
+    }
+    printf("===============================\n");
+}
+
+// show the total counts, and the tests and the rules with the most
+// instructions (or task clock without hardware counters)
+void ftw_perf_report_show(const ftw_perf_report * report, const ftw_perf * perf, unsigned int top) {
+    ftw_perf_test * tests = malloc(sizeof(ftw_perf_test) * (report->count + 1));
+    ftw_perf_test   total;
+    unsigned int    rules = 0;
+    int          (* cmp)(const void *, const void *) = (perf->fd[FTW_PERF_INSTRUCTIONS] >= 0) ? perf_instructions_cmp : perf_task_clock_cmp;
+
+    if (tests == NULL) {
+        return;
+    }
+    memset(&total, 0, sizeof(ftw_perf_test));
+    snprintf(total.test, sizeof(total.test), "%s", "TOTAL");
+    for (unsigned int i = 0; i < report->count; i++) {
+        for (int e = 0; e < FTW_PERF_COUNT; e++) {
+            total.counts.value[e] += report->tests[i].counts.value[e];
+        }
+        total.counts.time_enabled += report->tests[i].counts.time_enabled;
+        total.counts.time_running += report->tests[i].counts.time_running;
+    }
+    perf_header(perf, (perf->hardware == 1) ? "PERF COUNTERS" : "PERF COUNTERS (software)");
+    perf_show(perf, &total, 1, 1, 0);
+
+    memcpy(tests, report->tests, sizeof(ftw_perf_test) * report->count);
+    qsort(tests, report->count, sizeof(ftw_perf_test), cmp);
+    perf_header(perf, "COSTLIEST TESTS");
+    perf_show(perf, tests, report->count, top, 0);
+
+    // sum the tests of the rules
+    qsort(tests, report->count, sizeof(ftw_perf_test), perf_rule_cmp);
+    for (unsigned int i = 0; i < report->count; i++) {
+        if (rules > 0 && tests[rules - 1].rule_id == tests[i].rule_id) {
+            for (int e = 0; e < FTW_PERF_COUNT; e++) {
+                tests[rules - 1].counts.value[e] += tests[i].counts.value[e];
+            }
+            tests[rules - 1].counts.time_enabled += tests[i].counts.time_enabled;
+            tests[rules - 1].counts.time_running += tests[i].counts.time_running;
+        }
+        else {
+            tests[rules++] = tests[i];
+        }
+    }
+    qsort(tests, rules, sizeof(ftw_perf_test), cmp);
+    perf_header(perf, "COSTLIEST RULES");
+    perf_show(perf, tests, rules, top, 1);
+    free(tests);
+}
+
+void ftw_perf_report_free(ftw_perf_report * report) {
+    if (report != NULL) {
+        free(report->tests);
+        free(report);
+    }
+}
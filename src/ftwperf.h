@@ -0,0 +1,74 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwperf.h
+// performance counters of the transactions (perf_event_open)
+//
+
+#ifndef _FTWPERF_H
+#define _FTWPERF_H
+
+enum {
+    FTW_PERF_INSTRUCTIONS = 0,
+    FTW_PERF_CYCLES,
+    FTW_PERF_CACHE_MISSES,
+    FTW_PERF_BRANCH_MISSES,
+    FTW_PERF_PAGE_FAULTS,
+    FTW_PERF_TASK_CLOCK,        // ns
+    FTW_PERF_CONTEXT_SWITCHES,
+    FTW_PERF_COUNT
+};
+
+// the sums of ftw_perf_add() are scaled if the group was multiplexed
+typedef struct ftw_perf_values_t {
+    unsigned long long   value[FTW_PERF_COUNT];
+    unsigned long long   time_enabled;             // ns
+    unsigned long long   time_running;             // ns, less than enabled if multiplexed
+} ftw_perf_values;
+
+// the counters of the thread, read together as a group
+typedef struct ftw_perf_t {
+    int                  fd[FTW_PERF_COUNT];       // -1 if the counter isn't available
+    int                  position[FTW_PERF_COUNT]; // in the values of the group
+    unsigned int         count;                    // the opened counters
+    int                  hardware;                 // at least one hardware counter is available
+} ftw_perf;
+
+typedef struct ftw_perf_test_t {
+    char                 test[50];
+    unsigned int         rule_id;
+    ftw_perf_values      counts;
+} ftw_perf_test;
+
+// the counts of the transactions of the tests
+typedef struct ftw_perf_report_t {
+    ftw_perf_test      * tests;
+    unsigned int         count;
+    unsigned int         allocated;
+} ftw_perf_report;
+
+ftw_perf * ftw_perf_open(void);
+int        ftw_perf_read(const ftw_perf * perf, ftw_perf_values * values);
+void       ftw_perf_add(ftw_perf_values * sum, const ftw_perf_values * from, const ftw_perf_values * to);
+void       ftw_perf_close(ftw_perf * perf);
+
+void ftw_perf_report_add(ftw_perf_report * report, const char * test, unsigned int rule_id, const ftw_perf_values * counts);
+void ftw_perf_report_show(const ftw_perf_report * report, const ftw_perf * perf, unsigned int top);
+void ftw_perf_report_free(ftw_perf_report * report);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwprobes.h
+// static tracepoints (USDT) for perf, bpftrace and SystemTap
+//
+// the probes of the 'ftwrunner' provider:
+//   test_start(test, rule_id)           test_done(test, rule_id)
+//   stage_start(test, stage)            stage_done(test, stage, result)
+//   transaction_start()                 phase_done(phase, duration_ns)
+//   assertion_start()                   assertion_done(result)
+//   rules_load_start(uri)               rules_load_done(uri, failed)
+// a phase starts at the previous probe of the transaction
+// without <sys/sdt.h> the probes and their arguments are compiled out
+//
+
+#ifndef _FTWPROBES_H
+#define _FTWPROBES_H
+
+#include "config.h"
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define FTW_PROBE(name)              DTRACE_PROBE(ftwrunner, name)
+#define FTW_PROBE1(name, a)          DTRACE_PROBE1(ftwrunner, name, a)
+#define FTW_PROBE2(name, a, b)       DTRACE_PROBE2(ftwrunner, name, a, b)
+#define FTW_PROBE3(name, a, b, c)    DTRACE_PROBE3(ftwrunner, name, a, b, c)
+
+#else
+
+#define FTW_PROBE(name)              do { } while (0)
+#define FTW_PROBE1(name, a)          do { } while (0)
+#define FTW_PROBE2(name, a, b)       do { } while (0)
+#define FTW_PROBE3(name, a, b, c)    do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwprofile.c
+// profile of a run: the resources of the tests, and the time of the
+// parts of the run
+//
+// the tests are written to a tab separated file:
+//   <test> <rule> <wall ns> <thread CPU ns> <voluntary cs> <involuntary cs>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "ftwprofile.h"
+#include "ftwtestutils.h"
+
+#ifndef RUSAGE_THREAD
+// the context switches of the process on the systems without it
+#define RUSAGE_THREAD RUSAGE_SELF
+#endif
+
+void ftw_profile_mark_now(ftw_profile_mark * mark) {
+    struct timespec ts;
+    struct rusage   usage;
+
+    mark->wall_ns = monotonic_ns();
+    mark->cpu_ns  = 0;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        mark->cpu_ns = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+    mark->vcsw  = 0;
+    mark->ivcsw = 0;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        mark->vcsw  = usage.ru_nvcsw;
+        mark->ivcsw = usage.ru_nivcsw;
+    }
+}
+
+// add a test, which started at the given mark
+void ftw_profile_add_test(ftw_profile * profile, const char * test, unsigned int rule_id, const ftw_profile_mark * start) {
+    ftw_profile_mark   now;
+    ftw_test_profile * rec;
+
+    ftw_profile_mark_now(&now);
+    if (profile->count == profile->allocated) {
+        unsigned int       allocated = (profile->allocated == 0) ? 256 : profile->allocated * 2;
+        ftw_test_profile * tests     = realloc(profile->tests, sizeof(ftw_test_profile) * allocated);
+        if (tests == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        profile->tests     = tests;
+        profile->allocated = allocated;
+    }
+    rec = &profile->tests[profile->count++];
+    snprintf(rec->test, sizeof(rec->test), "%s", test);
+    rec->rule_id       = rule_id;
+    rec->used.wall_ns  = now.wall_ns - start->wall_ns;
+    rec->used.cpu_ns   = now.cpu_ns - start->cpu_ns;
+    rec->used.vcsw     = now.vcsw - start->vcsw;
+    rec->used.ivcsw    = now.ivcsw - start->ivcsw;
+}
+
+// write the tests
+// returns 0, or -1 on error
+int ftw_profile_write(const ftw_profile * profile, const char * path) {
+    FILE * fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        return -1;
+    }
+    fprintf(fp, "test\trule\twall_ns\tcpu_ns\tvoluntary_cs\tinvoluntary_cs\n");
+    for (unsigned int i = 0; i < profile->count; i++) {
+        const ftw_test_profile * rec = &profile->tests[i];
+        fprintf(fp, "%s\t%u\t%llu\t%llu\t%ld\t%ld\n", rec->test, rec->rule_id, rec->used.wall_ns, rec->used.cpu_ns, rec->used.vcsw, rec->used.ivcsw);
+    }
+    return (fclose(fp) == 0) ? 0 : -1;
+}
+
+// show the time of the parts of the run, the rest is the own work of
+// the runner between the parts, eg. the journal and the cache
+void ftw_profile_show(const ftw_profile * profile) {
+    static const char * names[FTW_PROFILE_COUNT] = {
+        "discovery", "parsing", "rule load", "engine calls", "assertions", "output", "teardown"
+    };
+    unsigned long long total = monotonic_ns() - profile->start_ns;
+    unsigned long long parts = 0;
+    unsigned long long cpu   = 0;
+    long               vcsw  = 0;
+    long               ivcsw = 0;
+
+    printf("RUN TIME (ms)\n");
+    for (int p = 0; p < FTW_PROFILE_COUNT; p++) {
+        printf("%-23s %10.2f %5.1f%%\n", names[p], profile->part_ns[p] / 1000000.0, (total > 0) ? 100.0 * profile->part_ns[p] / total : 0.0);
+        parts += profile->part_ns[p];
+    }
+    parts = (parts < total) ? total - parts : 0;
+    printf("%-23s %10.2f %5.1f%%\n", "other", parts / 1000000.0, (total > 0) ? 100.0 * parts / total : 0.0);
+    printf("%-23s %10.2f\n", "total", total / 1000000.0);
+    for (unsigned int i = 0; i < profile->count; i++) {
+        cpu   += profile->tests[i].used.cpu_ns;
+        vcsw  += profile->tests[i].used.vcsw;
+        ivcsw += profile->tests[i].used.ivcsw;
+    }
+    printf("TESTS CPU TIME:         %.2f ms\n", cpu / 1000000.0);
+    printf("CONTEXT SWITCHES:       %ld voluntary, %ld involuntary\n", vcsw, ivcsw);
+    printf("===============================\n");
+}
+
+void ftw_profile_free(ftw_profile * profile) {
+    if (profile != NULL) {
+        free(profile->tests);
+        free(profile);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwprofile.h
+// profile of a run: the resources of the tests, and the time of the
+// parts of the run
+//
+
+#ifndef _FTWPROFILE_H
+#define _FTWPROFILE_H
+
+// the parts of a run
+enum {
+    FTW_PROFILE_DISCOVERY = 0,     // walking the test root, the index and the selection
+    FTW_PROFILE_PARSING,           // the test files
+    FTW_PROFILE_RULE_LOAD,
+    FTW_PROFILE_ENGINE,            // the transactions
+    FTW_PROFILE_ASSERTIONS,        // the check of the logs
+    FTW_PROFILE_OUTPUT,            // the results and the summary
+    FTW_PROFILE_TEARDOWN,
+    FTW_PROFILE_COUNT
+};
+
+// the resources used by the thread until a moment
+typedef struct ftw_profile_mark_t {
+    unsigned long long   wall_ns;
+    unsigned long long   cpu_ns;       // CPU time of the thread
+    long                 vcsw;         // voluntary context switches
+    long                 ivcsw;        // involuntary context switches
+} ftw_profile_mark;
+
+typedef struct ftw_test_profile_t {
+    char                 test[50];
+    unsigned int         rule_id;
+    ftw_profile_mark     used;
+} ftw_test_profile;
+
+typedef struct ftw_profile_t {
+    unsigned long long   start_ns;
+    unsigned long long   part_ns[FTW_PROFILE_COUNT];
+    ftw_test_profile   * tests;
+    unsigned int         count;
+    unsigned int         allocated;
+} ftw_profile;
+
+void ftw_profile_mark_now(ftw_profile_mark * mark);
+void ftw_profile_add_test(ftw_profile * profile, const char * test, unsigned int rule_id, const ftw_profile_mark * start);
+int  ftw_profile_write(const ftw_profile * profile, const char * path);
+void ftw_profile_show(const ftw_profile * profile);
+void ftw_profile_free(ftw_profile * profile);
+
+#endif
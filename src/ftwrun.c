@@ -0,0 +1,561 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwrun.c
+// the run of the tests: the loading of the rules, the selection of the
+// tests, the run of the stages and the summary
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ftwrunner.h"
+#include "ftwrun.h"
+#include "ftwschedule.h"
+#include "ftwprobes.h"
+#include "ftwtestutils.h"
+#include "walkdir.h"
+
+// create an engine by name
+ftw_engine * ftw_run_engine_new(const char * name, char * rule_uri, const char ** errormsg) {
+    if (strcmp(name, "modsecurity") == 0) {
+        return ftw_engine_init(FTW_ENGINE_TYPE_MODSECURITY, rule_uri, errormsg);
+    }
+    else if (strcmp(name, "coraza") == 0) {
+        return ftw_engine_init(FTW_ENGINE_TYPE_CORAZA, rule_uri, errormsg);
+    }
+    return ftw_engine_init(FTW_ENGINE_TYPE_DUMMY, rule_uri, errormsg);
+}
+
+// create a temporary config file
+// the file is placed next to the main config, so the relative paths
+// in the copied directives stay valid; falls back to /tmp
+static FILE * config_tmpfile(const char * main_rule_uri, const char * name, char * path) {
+    char * dircopy = strdup(main_rule_uri);
+    int    fd;
+
+    if (dircopy == NULL) {
+        return NULL;
+    }
+    snprintf(path, PATH_MAX, "%s/.ftwrunner-%s-XXXXXX", dirname(dircopy), name);
+    free(dircopy);
+    if ((fd = mkstemp(path)) < 0) {
+        snprintf(path, PATH_MAX, "/tmp/ftwrunner-%s-XXXXXX", name);
+        if ((fd = mkstemp(path)) < 0) {
+            return NULL;
+        }
+    }
+    FILE * fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        close(fd);
+        unlink(path);
+    }
+    return fp;
+}
+
+// write a config with the kept files into a temporary file
+static int write_config(const ftw_ruleindex * index, const char * main_rule_uri, const int * keep, int directives, const char * name, char * path) {
+    FILE * fp = config_tmpfile(main_rule_uri, name, path);
+    int    kept;
+
+    if (fp == NULL) {
+        return -1;
+    }
+    kept = ftw_ruleindex_write(index, keep, directives, fp);
+    fclose(fp);
+    if (kept < 0) {
+        unlink(path);
+    }
+    return kept;
+}
+
+// split the kept rule files into groups with similar size in the include
+// order, and write a config for every group
+// the own directives of the container files go into the first group
+// returns the number of the written groups
+static int write_group_configs(const ftw_ruleindex * index, const char * main_rule_uri, const int * keep, int group_count, char ** paths) {
+    int       * group  = malloc(index->files_count * sizeof(int));
+    int       * gkeep  = calloc(index->files_count, sizeof(int));
+    long long * sizes  = calloc(index->files_count, sizeof(long long));
+    long long   total  = 0;
+    long long   acc    = 0;
+    int         leaves = 0;
+    int         g      = 0;
+    int         used   = 0;
+
+    if (group == NULL || gkeep == NULL || sizes == NULL) {
+        free(group);
+        free(gkeep);
+        free(sizes);
+        return 0;
+    }
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        struct stat st;
+        group[i] = -1;
+        if (index->files[i].includes > 0 || (keep != NULL && keep[i] == 0)) {
+            continue;
+        }
+        sizes[i] = (stat(index->files[i].path, &st) == 0 && st.st_size > 0) ? st.st_size : 1;
+        total   += sizes[i];
+        leaves++;
+    }
+    if (leaves < group_count) {
+        group_count = leaves;
+    }
+    for (unsigned int i = 0; i < index->files_count && group_count > 1; i++) {
+        if (sizes[i] == 0) {
+            continue;
+        }
+        group[i] = g;
+        used     = g + 1;
+        acc     += sizes[i];
+        if (g < group_count - 1 && acc * group_count >= total * (g + 1)) {
+            g++;
+        }
+    }
+    for (g = 0; g < used; g++) {
+        for (unsigned int i = 0; i < index->files_count; i++) {
+            gkeep[i] = (group[i] == g) ? 1 : 0;
+        }
+        paths[g] = malloc(PATH_MAX);
+        if (paths[g] == NULL || write_config(index, main_rule_uri, gkeep, (g == 0) ? 1 : 0, "group", paths[g]) < 0) {
+            free(paths[g]);
+            while (--g >= 0) {
+                unlink(paths[g]);
+                free(paths[g]);
+            }
+            used = 0;
+            break;
+        }
+    }
+    free(group);
+    free(gkeep);
+    free(sizes);
+    return used;
+}
+
+// index the rules if any feature needs it
+ftw_ruleindex * ftw_run_index_rules(const ftw_run_opts * opts, int force) {
+    ftw_ruleindex * ruleindex = NULL;
+
+    if (force == 1 || (opts->all_phases == 0 && strcmp(opts->ftwengine, "dummy") != 0) || opts->minimal_config == 1 || opts->rule_groups > 1) {
+        ruleindex = ftw_ruleindex_new(opts->modsecurity_config);
+        if (ruleindex == NULL && opts->all_phases == 0) {
+            fprintf(stderr, "Warning: can't index the rules, all phases will be processed\n");
+        }
+    }
+    return ruleindex;
+}
+
+// signature of the config files and their data files: their paths, sizes
+// and modification times
+unsigned long long ftw_run_config_signature(const ftw_ruleindex * ruleindex, const char * main_rule_uri) {
+    unsigned long long sig   = FNV1A_INIT;
+    unsigned int       count = (ruleindex != NULL) ? ruleindex->files_count + ruleindex->data_files_count : 1;
+
+    for (unsigned int i = 0; i < count; i++) {
+        const char * path = (ruleindex == NULL) ? main_rule_uri :
+                            (i < ruleindex->files_count) ? ruleindex->files[i].path : ruleindex->data_files[i - ruleindex->files_count];
+        struct stat  st;
+        sig = hash_fnv1a(path, strlen(path) + 1, sig);
+        if (stat(path, &st) == 0) {
+            sig = hash_fnv1a(&st.st_size, sizeof(st.st_size), sig);
+            sig = hash_fnv1a(&st.st_mtim, sizeof(st.st_mtim), sig);
+        }
+    }
+    return sig;
+}
+
+// create the engine and load the rules
+// the engine takes the ownership of the rule index
+// returns NULL on error
+ftw_engine * ftw_run_load_engine(const ftw_run_opts * opts, ftw_ruleindex * ruleindex, const char ** errormsg) {
+    ftw_engine  * engine      = NULL;
+    char        * rule_uri    = opts->modsecurity_config;
+    char          minimal_uri[PATH_MAX] = "";
+    int         * keep        = NULL;
+    char       ** group_uris  = NULL;
+    int           group_count = 0;
+    unsigned int  rule_test   = opts->rule_test;
+
+    if (opts->minimal_config == 1) {
+        int kept = -1;
+        if (ruleindex != NULL && (keep = ftw_ruleindex_keep_minimal(ruleindex, &rule_test, 1)) != NULL) {
+            kept = write_config(ruleindex, opts->modsecurity_config, keep, 1, "minimal", minimal_uri);
+        }
+        if (kept < 0) {
+            *errormsg = "can't create minimal config";
+            free(keep);
+            ftw_ruleindex_free(ruleindex);
+            return NULL;
+        }
+        printf("Minimal config: %d of %u files loaded\n", kept, ruleindex->files_count);
+        rule_uri = minimal_uri;
+    }
+    if (opts->rule_groups > 1 && ruleindex != NULL) {
+        group_uris  = calloc(opts->rule_groups, sizeof(char *));
+        group_count = (group_uris != NULL) ? write_group_configs(ruleindex, opts->modsecurity_config, keep, opts->rule_groups, group_uris) : 0;
+        if (group_count < 2) {
+            fprintf(stderr, "Warning: can't split the rule files into groups, rules will be loaded at once\n");
+        }
+    }
+    free(keep);
+
+    if (group_count > 1) {
+        engine = ftw_engine_init_groups(FTW_ENGINE_TYPE_MODSECURITY, group_uris, group_count, errormsg);
+        printf("Rules loaded in %d merged groups\n", group_count);
+    }
+    else {
+        engine = ftw_run_engine_new(opts->ftwengine, rule_uri, errormsg);
+    }
+    if (strlen(minimal_uri) > 0) {
+        unlink(minimal_uri);
+    }
+    for (int i = 0; i < group_count; i++) {
+        unlink(group_uris[i]);
+        free(group_uris[i]);
+    }
+    free(group_uris);
+
+    if (*errormsg != NULL) {
+        ftw_engine_free(engine);
+        ftw_ruleindex_free(ruleindex);
+        return NULL;
+    }
+    engine->stop_on_disruptive = opts->stop_on_disruptive;
+    if (opts->all_phases == 0) {
+        engine->ruleindex = ruleindex;
+    }
+    else {
+        ftw_ruleindex_free(ruleindex);
+    }
+    return engine;
+}
+
+// the path of a test file relative to the test root
+const char * ftw_run_relative_path(const ftw_run_opts * opts, const char * path) {
+    size_t rootlen = strlen(opts->ftwtest_root);
+
+    while (rootlen > 1 && opts->ftwtest_root[rootlen - 1] == '/') {
+        rootlen--;
+    }
+    if (strncmp(path, opts->ftwtest_root, rootlen) == 0 && path[rootlen] == '/') {
+        return path + rootlen + 1;
+    }
+    return path;
+}
+
+// check whether a test is selected by '-r', '-t' and '-s'
+// path is relative to the test root
+int ftw_run_selected(const ftw_run_opts * opts, unsigned int rule_id, unsigned int test_id, const char * path, char * const * tags, unsigned int tags_count) {
+    if ((opts->rule_test != 0 && opts->rule_test != rule_id) || (opts->rule_test_id != 0 && opts->rule_test_id != test_id)) {
+        return 0;
+    }
+    if (opts->selection != NULL && ftw_selection_match(opts->selection, rule_id, test_id, path, tags, tags_count) == 0) {
+        return 0;
+    }
+    if (opts->sample != NULL) {
+        char test_full_id[50];
+        sprintf(test_full_id, "%u-%u", rule_id, test_id);
+        return ftw_sample_contains(opts->sample, test_full_id);
+    }
+    return 1;
+}
+
+// write the span of a stage and its phases to the trace
+static void trace_stage(ftw_trace * trace, const ftw_engine * engine, const char * test, int stage, int result, unsigned long long start_ns, unsigned long long end_ns) {
+    char               name[20];
+    char               args[100];
+    unsigned long long phase_start = engine->phase_mark;
+
+    snprintf(name, sizeof(name), "stage %d", stage);
+    snprintf(args, sizeof(args), "\"test\":\"%s\",\"result\":%d", test, result);
+    ftw_trace_span(trace, "stage", name, start_ns, end_ns, args);
+    // the phases ran after each other until the last mark
+    for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+        if (engine->phase_mask & (1U << p)) {
+            phase_start -= engine->phase_ns[p];
+        }
+    }
+    for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+        if (engine->phase_mask & (1U << p)) {
+            ftw_trace_span(trace, "phase", ftw_engine_phase_name(p), phase_start, phase_start + engine->phase_ns[p], NULL);
+            phase_start += engine->phase_ns[p];
+        }
+    }
+}
+
+// run a test, its stages are checked against the journal of the last run
+// the stages which give different result with the full config are added
+// to the mismatch list
+void ftw_run_test(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, const ftwtestcollection * collection, const ftwtest * test, char *** mismatch_list, int * mismatch_count) {
+    char             test_full_id[50];
+    ftw_profile_mark test_start;
+    unsigned long long test_start_ns = 0;
+
+    sprintf(test_full_id, "%u-%u", collection->rule_id, test->test_id);
+    if (opts->affected_by != NULL && opts->affected_all == 0
+        && ftw_impact_test_affected(opts->fired, test_full_id, collection->rule_id, opts->affected_ids, opts->affected_ids_count) == 0) {
+        engine->cnt_not_affected++;
+        return;
+    }
+    if (opts->profile != NULL) {
+        ftw_profile_mark_now(&test_start);
+    }
+    if (opts->trace != NULL) {
+        test_start_ns = monotonic_ns();
+    }
+    FTW_PROBE2(test_start, test_full_id, collection->rule_id);
+    for(int si = 0; si < test->stages_count; si++) {
+        ftw_stage *stage = test->stages[si];
+        int wl = qsearch(opts->test_whitelist, opts->test_whitelist_count, test_full_id);
+        const ftw_journal_entry * prev = (opts->journal != NULL && opts->journal_mode != FTW_JOURNAL_NEW) ? ftw_journal_find(opts->journal, test_full_id, si) : NULL;
+        if (opts->journal_mode >= FTW_JOURNAL_RERUN_FAILED && prev == NULL) {
+            // only the tests of the last run
+            continue;
+        }
+        if (prev != NULL && (opts->journal_mode == FTW_JOURNAL_RESUME || (prev->result != FTW_TEST_FAIL && prev->result != FTW_TEST_TIMEOUT)
+                || (wl >= 0 && opts->journal_mode != FTW_JOURNAL_RERUN_FAILED_ALL))) {
+            engine_replay(engine, ((wl >= 0) ? 1 : 0), test_full_id, prev->result);
+            if (opts->journal_mode != FTW_JOURNAL_RESUME) {
+                ftw_journal_append(opts->journal, test_full_id, si, prev->result, prev->duration_ns, NULL, 0);
+            }
+            continue;
+        }
+        unsigned long long start = monotonic_ns();
+        FTW_PROBE2(stage_start, test_full_id, si);
+        int res = engine_runtest(engine, collection->meta.enabled, ((wl >= 0) ? 1 : 0), test_full_id, stage, opts->debug, opts->verbose);
+        FTW_PROBE3(stage_done, test_full_id, si, res);
+        if (opts->trace != NULL) {
+            trace_stage(opts->trace, engine, test_full_id, si, res, start, monotonic_ns());
+        }
+        if (opts->latency != NULL && (engine->phase_mask & ~(1U << FTW_PHASE_CHECK)) != 0) {
+            // the transaction, without the check of the log
+            unsigned long long time_ns = 0;
+            for (int p = 0; p < FTW_PHASE_CHECK; p++) {
+                time_ns += (engine->phase_mask & (1U << p)) ? engine->phase_ns[p] : 0;
+            }
+            ftw_latency_add(opts->latency, test_full_id, collection->rule_id, ftw_stage_payload(stage), time_ns);
+        }
+        if (opts->allocs != NULL && (engine->phase_mask & ~(1U << FTW_PHASE_CHECK)) != 0) {
+            ftw_alloc_counters used = {0};
+            for (int p = 0; p < FTW_PHASE_CHECK; p++) {
+                if (engine->phase_mask & (1U << p)) {
+                    used.allocs += engine->phase_alloc[p].allocs;
+                    used.frees  += engine->phase_alloc[p].frees;
+                    used.bytes  += engine->phase_alloc[p].bytes;
+                }
+            }
+            ftw_alloc_report_add(opts->allocs, test_full_id, collection->rule_id, &used);
+        }
+        if (opts->perf != NULL && (engine->phase_mask & ~(1U << FTW_PHASE_CHECK)) != 0) {
+            ftw_perf_report_add(opts->perf_report, test_full_id, collection->rule_id, &engine->perf_stage);
+        }
+        if (opts->journal != NULL) {
+            unsigned long long phases_ns[FTW_PHASE_COUNT];
+            for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+                phases_ns[p] = (engine->phase_mask & (1U << p)) ? engine->phase_ns[p] : 0;
+            }
+            ftw_journal_append(opts->journal, test_full_id, si, res, monotonic_ns() - start, phases_ns, (engine->phase_mask != 0) ? FTW_PHASE_COUNT : 0);
+        }
+        if (engine_full != NULL && (res == FTW_TEST_PASS || res == FTW_TEST_FAIL)) {
+            // the same stage with the full config
+            int full_res = engine_full->runtest(engine_full, test_full_id, stage, 0, 0);
+            if (full_res != res) {
+                char mismatch[100];
+                sprintf(mismatch, "%s (%s: %s, full: %s)", test_full_id, (opts->minimal_config == 1) ? "minimal" : "merged",
+                    (res == FTW_TEST_PASS) ? "PASSED" : "FAILED", (full_res == FTW_TEST_PASS) ? "PASSED" : "FAILED");
+                *mismatch_list = realloc(*mismatch_list, sizeof(char *) * (*mismatch_count + 2));
+                (*mismatch_list)[(*mismatch_count)++] = strdup(mismatch);
+                (*mismatch_list)[*mismatch_count] = NULL;
+            }
+        }
+    }
+    FTW_PROBE2(test_done, test_full_id, collection->rule_id);
+    if (opts->trace != NULL) {
+        char args[50];
+        snprintf(args, sizeof(args), "\"rule\":%u", collection->rule_id);
+        ftw_trace_span(opts->trace, "test", test_full_id, test_start_ns, monotonic_ns(), args);
+    }
+    if (opts->profile != NULL) {
+        ftw_profile_add_test(opts->profile, test_full_id, collection->rule_id, &test_start);
+    }
+}
+
+// run the selected tests of a collection
+void ftw_run_collection(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, const char * path, const ftwtestcollection * collection, char *** mismatch_list, int * mismatch_count) {
+    if (collection->meta.enabled) {
+        for(int t = 0; t < collection->test_count; t++) {
+            ftwtest *test = collection->tests[t];
+            if (ftw_run_selected(opts, collection->rule_id, test->test_id, ftw_run_relative_path(opts, path), collection->meta.tags, collection->meta.tagcnt) == 1) {
+                ftw_run_test(engine, engine_full, opts, collection, test, mismatch_list, mismatch_count);
+            }
+        }
+    }
+}
+
+// parse a test file of the run
+// returns NULL if the file isn't selected or it can't be parsed
+ftwtestcollection * ftw_run_parse_file(const ftw_run_opts * opts, const char * path, yaml_item ** yroot) {
+    ftwtestcollection  * collection;
+    unsigned long long   start = monotonic_ns();
+
+    if (opts->selection != NULL && ftw_selection_match_path(opts->selection, ftw_run_relative_path(opts, path)) == 0) {
+        return NULL;
+    }
+    if ((*yroot = parse_yaml(path)) == NULL) {
+        fprintf(stderr, "Error: failed to parse YAML file: %s\n", path);
+        return NULL;
+    }
+    collection = ftwtestcollection_new(*yroot, opts->rule_test, opts->rule_test_id);
+    if (collection == NULL) {
+        fprintf(stderr, "Error parsing file %s! (Memory allocation error)\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (opts->profile != NULL) {
+        opts->profile->part_ns[FTW_PROFILE_PARSING] += monotonic_ns() - start;
+    }
+    if (opts->trace != NULL) {
+        ftw_trace_span(opts->trace, "parsing", ftw_run_relative_path(opts, path), start, monotonic_ns(), NULL);
+    }
+    return collection;
+}
+
+// parse all of the given files
+// the paths are taken over by the returned files
+ftw_parsed_file * ftw_run_parse_files(const ftw_run_opts * opts, char ** tests, unsigned test_count) {
+    ftw_parsed_file * files = calloc(test_count + 1, sizeof(ftw_parsed_file));
+
+    if (files == NULL) {
+        fprintf(stderr, "Error: out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned i = 0; i < test_count; i++) {
+        files[i].path       = tests[i];
+        files[i].collection = ftw_run_parse_file(opts, tests[i], &files[i].yroot);
+    }
+    return files;
+}
+
+void ftw_run_free_files(ftw_parsed_file * files, unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        if (files[i].collection != NULL) {
+            ftwtestcollection_free(files[i].collection);
+        }
+        if (files[i].yroot != NULL) {
+            yaml_item_free(files[i].yroot);
+        }
+        free(files[i].path);
+    }
+    free(files);
+}
+
+// run the tests of the given files, and show the results
+// the list of the files is freed
+// returns the number of the failed tests and the mismatches
+unsigned ftw_run_tests(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, char ** tests, unsigned test_count) {
+    char    ** mismatch_list  = NULL;
+    int        mismatch_count = 0;
+    unsigned   failed_count   = 0;
+    char    ** untested       = NULL;
+    unsigned   untested_count = 0;
+    unsigned long long output_start;
+
+    qsort(tests, test_count, sizeof(char *), walkcmp);
+    if (opts->deadline_ns > 0) {
+        untested = ftw_schedule_run(engine, engine_full, opts, tests, test_count, &mismatch_list, &mismatch_count, &untested_count);
+    }
+    else if (opts->soak != NULL) {
+        ftw_soak_run(engine, engine_full, opts, tests, test_count, &mismatch_list, &mismatch_count);
+    }
+    else {
+        for(int i = 0; i < test_count; i++) {
+            yaml_item         * yrootsub   = NULL;
+            ftwtestcollection * collection = ftw_run_parse_file(opts, tests[i], &yrootsub);
+            if (collection != NULL) {
+                ftw_run_collection(engine, engine_full, opts, tests[i], collection, &mismatch_list, &mismatch_count);
+                ftwtestcollection_free(collection);
+                yaml_item_free(yrootsub);
+            }
+            free(tests[i]);
+        }
+    }
+    free(tests);
+    if (opts->journal != NULL && untested_count == 0) {
+        // a run stopped by the time budget can be resumed
+        ftw_journal_finish(opts->journal);
+    }
+    output_start = monotonic_ns();
+    ftw_engine_show_result(engine);
+    if (opts->affected_by != NULL) {
+        printf("NOT AFFECTED (not run): %d\n", engine->cnt_not_affected);
+        printf("===============================\n");
+    }
+    if (opts->sample != NULL) {
+        ftw_sample_show(opts->sample);
+    }
+    if (opts->latency != NULL) {
+        ftw_latency_show(opts->latency, opts->slowest);
+    }
+    if (opts->allocs != NULL) {
+        ftw_alloc_report_show(opts->allocs, opts->alloc_top);
+    }
+    if (opts->perf != NULL) {
+        ftw_perf_report_show(opts->perf_report, opts->perf, opts->perf_top);
+    }
+    if (opts->soak != NULL) {
+        ftw_soak_show(opts->soak, opts->soak_threshold);
+    }
+    if (opts->deadline_ns > 0) {
+        printf("UNTESTED (time budget): %u\n", untested_count);
+        if (untested_count > 0) {
+            printf("UNTESTED TESTS:\n");
+            for (unsigned i = 0; i < untested_count; i++) {
+                printf("%s\n", untested[i]);
+            }
+        }
+        printf("===============================\n");
+        FTW_FREE_STRINGLIST(untested);
+    }
+    if (engine_full != NULL) {
+        printf("%s MISMATCHES: %d\n", (opts->minimal_config == 1) ? "MINIMAL CONFIG" : "MERGED RULES", mismatch_count);
+        for (int i = 0; i < mismatch_count; i++) {
+            printf("%s\n", mismatch_list[i]);
+        }
+        printf("===============================\n");
+    }
+    logCbClearLog();
+    if (opts->profile != NULL) {
+        for (int p = 0; p < FTW_PHASE_COUNT; p++) {
+            opts->profile->part_ns[(p == FTW_PHASE_CHECK) ? FTW_PROFILE_ASSERTIONS : FTW_PROFILE_ENGINE] += engine->phase_hist[p].sum;
+        }
+        opts->profile->part_ns[FTW_PROFILE_OUTPUT] += engine->output_ns + monotonic_ns() - output_start;
+    }
+    if (opts->trace != NULL) {
+        ftw_trace_span(opts->trace, "run", "summary", output_start, monotonic_ns(), NULL);
+    }
+
+    failed_count = engine->cnt_failed + engine->cnt_timeout + mismatch_count;
+    FTW_FREE_STRINGLIST(mismatch_list);
+    return failed_count;
+}
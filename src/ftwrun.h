@@ -0,0 +1,111 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwrun.h
+// the run of the tests: the options, the loading of the rules, the
+// selection, and the run of the test files
+//
+
+#ifndef _FTWRUN_H
+#define _FTWRUN_H
+
+#include "ftwselect.h"
+#include "ftwimpact.h"
+#include "ftwjournal.h"
+#include "ftwsample.h"
+#include "ftwprofile.h"
+#include "ftwlatency.h"
+#include "ftwalloc.h"
+#include "ftwsoak.h"
+#include "ftwperf.h"
+#include "ftwtrace.h"
+#include "ftwtest.h"
+#include "yamlapi.h"
+#include "engines/engines.h"
+
+
+// options of the runs
+typedef struct ftw_run_opts_t {
+    char          * ftwengine;
+    char          * modsecurity_config;
+    char          * ftwtest_root;
+    unsigned int    rule_test;
+    unsigned int    rule_test_id;
+    const char    * select_expr;       // '-s'
+    ftw_selection * selection;
+    char         ** test_whitelist;
+    int             test_whitelist_count;
+    int             debug;
+    int             verbose;
+    int             stop_on_disruptive;
+    int             all_phases;
+    int             minimal_config;
+    int             rule_groups;
+    const char    * affected_by;       // the change for the impact analysis
+    unsigned int  * affected_ids;      // the changed rules
+    unsigned int    affected_ids_count;
+    int             affected_all;      // the change can affect every test
+    ftw_fired_db  * fired;
+    ftw_journal   * journal;
+    int             journal_mode;
+    const char    * sample_arg;        // '--sample'
+    ftw_sample    * sample;
+    unsigned long long deadline_ns;    // the end of '--time-budget'
+    ftw_profile   * profile;           // '--profile'
+    ftw_latency   * latency;           // '--slowest'
+    unsigned int    slowest;
+    ftw_alloc_report * allocs;         // '--alloc-stats'
+    unsigned int    alloc_top;
+    ftw_soak      * soak;              // '--soak'
+    long long       soak_threshold;
+    ftw_perf      * perf;              // '--perf-counters'
+    ftw_perf_report * perf_report;
+    unsigned int    perf_top;
+    ftw_trace     * trace;             // '--trace'
+} ftw_run_opts;
+
+// modes of the journal
+enum {
+    FTW_JOURNAL_NEW = 0,
+    FTW_JOURNAL_RESUME,
+    FTW_JOURNAL_RERUN_FAILED,
+    FTW_JOURNAL_RERUN_FAILED_ALL
+};
+
+// a parsed test file, kept in the memory by the watch mode, the time
+// budget and the soak runs
+typedef struct ftw_parsed_file_t {
+    char              * path;
+    yaml_item         * yroot;
+    ftwtestcollection * collection;
+} ftw_parsed_file;
+
+ftw_engine        * ftw_run_engine_new(const char * name, char * rule_uri, const char ** errormsg);
+ftw_ruleindex     * ftw_run_index_rules(const ftw_run_opts * opts, int force);
+unsigned long long  ftw_run_config_signature(const ftw_ruleindex * ruleindex, const char * main_rule_uri);
+ftw_engine        * ftw_run_load_engine(const ftw_run_opts * opts, ftw_ruleindex * ruleindex, const char ** errormsg);
+const char        * ftw_run_relative_path(const ftw_run_opts * opts, const char * path);
+int                 ftw_run_selected(const ftw_run_opts * opts, unsigned int rule_id, unsigned int test_id, const char * path, char * const * tags, unsigned int tags_count);
+void                ftw_run_test(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, const ftwtestcollection * collection, const ftwtest * test, char *** mismatch_list, int * mismatch_count);
+void                ftw_run_collection(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, const char * path, const ftwtestcollection * collection, char *** mismatch_list, int * mismatch_count);
+ftwtestcollection * ftw_run_parse_file(const ftw_run_opts * opts, const char * path, yaml_item ** yroot);
+ftw_parsed_file   * ftw_run_parse_files(const ftw_run_opts * opts, char ** tests, unsigned test_count);
+void                ftw_run_free_files(ftw_parsed_file * files, unsigned count);
+unsigned            ftw_run_tests(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, char ** tests, unsigned test_count);
+
+#endif
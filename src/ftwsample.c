@@ -0,0 +1,298 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwsample.c
+// stratified sample of the tests for the smoke runs
+//
+// the candidates are grouped by their category directory (the first
+// directory under the test root) and their rule id
+// the tests of a category have a fixed position, given by the order of
+// the hash of their ids; a sample of 1/W of the candidates takes the tests
+// with (position + seed) % W == 0, so every test is chosen once in W runs
+// with consecutive seeds, and the categories get their share; every rule
+// keeps at least one test, which rotates in the same way
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftwsample.h"
+#include "ftwrun.h"
+#include "ftwtestutils.h"
+
+typedef struct sample_item_t {
+    const char         * category;
+    size_t               category_len;
+    unsigned int         rule_id;
+    unsigned long long   hash;
+    unsigned int         test;       // index in ftw_testindex.tests
+    int                  chosen;
+} sample_item;
+
+static int sample_category_cmp(const sample_item * a, const sample_item * b) {
+    size_t len = (a->category_len < b->category_len) ? a->category_len : b->category_len;
+    int    cmp = strncmp(a->category, b->category, len);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (a->category_len > b->category_len) - (a->category_len < b->category_len);
+}
+
+// order by category, rule id and hash
+static int sample_item_cmp(const void *p1, const void *p2) {
+    const sample_item * a   = p1;
+    const sample_item * b   = p2;
+    int                 cmp = sample_category_cmp(a, b);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (a->rule_id != b->rule_id) {
+        return (a->rule_id > b->rule_id) ? 1 : -1;
+    }
+    return (a->hash > b->hash) - (a->hash < b->hash);
+}
+
+// order by hash
+static int sample_hash_cmp(const void *p1, const void *p2) {
+    const sample_item * a = *(sample_item * const *)p1;
+    const sample_item * b = *(sample_item * const *)p2;
+    return (a->hash > b->hash) - (a->hash < b->hash);
+}
+
+static int sample_test_cmp(const void *p1, const void *p2) {
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+static int sample_rule_cmp(const void *p1, const void *p2) {
+    unsigned int a = *(const unsigned int *)p1;
+    unsigned int b = *(const unsigned int *)p2;
+    return (a > b) - (a < b);
+}
+
+// number of the distinct rules of the items, or of the chosen ones
+// a rule can have tests in more categories
+static unsigned int sample_count_rules(const sample_item * items, unsigned int count, int chosen) {
+    unsigned int * ids       = malloc(sizeof(unsigned int) * (count + 1));
+    unsigned int   ids_count = 0;
+    unsigned int   rules     = 0;
+
+    if (ids == NULL) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        if (chosen == 0 || items[i].chosen == 1) {
+            ids[ids_count++] = items[i].rule_id;
+        }
+    }
+    qsort(ids, ids_count, sizeof(unsigned int), sample_rule_cmp);
+    for (unsigned int i = 0; i < ids_count; i++) {
+        if (i == 0 || ids[i] != ids[i - 1]) {
+            rules++;
+        }
+    }
+    free(ids);
+    return rules;
+}
+
+// the first directory of a path under the root
+static const char * sample_category(const char * root, const char * path, size_t * len) {
+    size_t rootlen = strlen(root);
+
+    while (rootlen > 1 && root[rootlen - 1] == '/') {
+        rootlen--;
+    }
+    if (strncmp(path, root, rootlen) == 0 && path[rootlen] == '/') {
+        path += rootlen + 1;
+    }
+    *len = strcspn(path, "/");
+    if (path[*len] == '\0') {
+        // the file is in the root
+        *len = 0;
+    }
+    return path;
+}
+
+// choose a sample of target tests from the candidates of the index
+// returns NULL on memory allocation error
+ftw_sample * ftw_sample_new(const ftw_testindex * index, const int * candidate, unsigned int target, unsigned long long seed) {
+    ftw_sample   * sample = calloc(1, sizeof(ftw_sample));
+    sample_item  * items  = calloc(index->tests_count + 1, sizeof(sample_item));
+    sample_item ** order  = calloc(index->tests_count + 1, sizeof(sample_item *));
+    unsigned int   count  = 0;
+
+    if (sample == NULL || items == NULL || order == NULL) {
+        free(sample);
+        free(items);
+        free(order);
+        return NULL;
+    }
+    sample->seed = seed;
+    for (unsigned int i = 0; i < index->tests_count; i++) {
+        const ftw_indexed_test * test = &index->tests[i];
+        char                     id[50];
+
+        if (candidate[i] == 0) {
+            continue;
+        }
+        sprintf(id, "%u-%u", test->rule_id, test->test_id);
+        items[count].category = sample_category(index->root, index->files[test->file].path, &items[count].category_len);
+        items[count].rule_id  = test->rule_id;
+        // not seeded: the position of a test doesn't change between runs
+        items[count].hash     = hash_fnv1a(id, strlen(id), FNV1A_INIT);
+        items[count].test     = i;
+        count++;
+    }
+    sample->candidates = count;
+    // the sample is 1/window of the candidates
+    sample->window = (target > 0 && target < count) ? (count + target - 1) / target : 1;
+    qsort(items, count, sizeof(sample_item), sample_item_cmp);
+
+    for (unsigned int first = 0; first < count; ) {
+        unsigned int last = first;
+
+        while (last < count && sample_category_cmp(&items[first], &items[last]) == 0) {
+            order[last - first] = &items[last];
+            last++;
+        }
+        qsort(order, last - first, sizeof(sample_item *), sample_hash_cmp);
+        for (unsigned int i = 0; i < last - first; i++) {
+            order[i]->chosen = ((i + seed) % sample->window == 0) ? 1 : 0;
+        }
+        // a rule without chosen test gets one in its turn
+        for (unsigned int rfirst = first; rfirst < last; ) {
+            unsigned int rlast  = rfirst;
+            int          chosen = 0;
+
+            while (rlast < last && items[rlast].rule_id == items[rfirst].rule_id) {
+                chosen |= items[rlast].chosen;
+                rlast++;
+            }
+            if (chosen == 0) {
+                items[rfirst + seed % (rlast - rfirst)].chosen = 1;
+            }
+            rfirst = rlast;
+        }
+        sample->categories++;
+        first = last;
+    }
+
+    sample->rules       = sample_count_rules(items, count, 1);
+    sample->total_rules = sample_count_rules(items, count, 0);
+    for (unsigned int i = 0; i < count; i++) {
+        if (items[i].chosen == 1) {
+            const ftw_indexed_test * test = &index->tests[items[i].test];
+            char                     id[50];
+            char                  ** tests = realloc(sample->tests, sizeof(char *) * (sample->count + 1));
+
+            if (tests == NULL) {
+                free(items);
+                free(order);
+                ftw_sample_free(sample);
+                return NULL;
+            }
+            sprintf(id, "%u-%u", test->rule_id, test->test_id);
+            sample->tests = tests;
+            sample->tests[sample->count++] = strdup(id);
+        }
+    }
+    qsort(sample->tests, sample->count, sizeof(char *), sample_test_cmp);
+    free(items);
+    free(order);
+    return sample;
+}
+
+void ftw_sample_free(ftw_sample * sample) {
+    if (sample != NULL) {
+        for (unsigned int i = 0; i < sample->count; i++) {
+            free(sample->tests[i]);
+        }
+        free(sample->tests);
+        free(sample);
+    }
+}
+
+// check whether a test is in the sample
+int ftw_sample_contains(const ftw_sample * sample, const char * test) {
+    return (bsearch(&test, sample->tests, sample->count, sizeof(char *), sample_test_cmp) != NULL) ? 1 : 0;
+}
+
+// parse the argument of '--sample': a percent of the tests, or a number
+// returns 0 on error
+double ftw_sample_size(const char * arg, int * percent) {
+    char   * end;
+    double   size = strtod(arg, &end);
+
+    *percent = (*end == '%') ? 1 : 0;
+    if (end == arg || (*percent == 1 && end[1] != '\0') || (*percent == 0 && (*end != '\0' || size != (unsigned int)size))
+        || size <= 0 || (*percent == 1 && size > 100)) {
+        return 0;
+    }
+    return size;
+}
+
+// choose the sample of '--sample' from the enabled and not skipped tests
+// selected by '-r', '-t' and '-s'
+ftw_sample * ftw_sample_tests(const ftw_run_opts * opts, const ftw_testindex * index, unsigned long long seed) {
+    int          * candidate  = calloc(index->tests_count + 1, sizeof(int));
+    unsigned int   candidates = 0;
+    unsigned int   target;
+    int            percent;
+    double         size       = ftw_sample_size(opts->sample_arg, &percent);
+    ftw_sample   * sample;
+
+    if (candidate == NULL) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < index->tests_count; i++) {
+        const ftw_indexed_test * test = &index->tests[i];
+        const ftw_indexed_file * file = &index->files[test->file];
+
+        if (test->enabled == 1 && test->skip == NULL
+            && ftw_run_selected(opts, test->rule_id, test->test_id, ftw_run_relative_path(opts, file->path), file->tags, file->tags_count) == 1) {
+            candidate[i] = 1;
+            candidates++;
+        }
+    }
+    target = (unsigned int)size;
+    if (percent == 1) {
+        // round up, a small sample keeps at least one test
+        double share = candidates * size / 100;
+        target = (unsigned int)share;
+        if (target < share) {
+            target++;
+        }
+    }
+    sample = ftw_sample_new(index, candidate, target, seed);
+    free(candidate);
+    return sample;
+}
+
+// show the coverage of the sample
+void ftw_sample_show(const ftw_sample * sample) {
+    printf("SAMPLE SEED:            %llu\n", sample->seed);
+    printf("SAMPLED TESTS:          %u of %u (%.1f%%)\n", sample->count, sample->candidates,
+        (sample->candidates > 0) ? 100.0 * sample->count / sample->candidates : 0.0);
+    printf("SAMPLED RULES:          %u of %u (%.1f%%)\n", sample->rules, sample->total_rules,
+        (sample->total_rules > 0) ? 100.0 * sample->rules / sample->total_rules : 0.0);
+    printf("SAMPLED CATEGORIES:     %u\n", sample->categories);
+    printf("SAMPLE WINDOW:          %u runs\n", sample->window);
+    printf("===============================\n");
+}
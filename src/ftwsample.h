@@ -0,0 +1,48 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwsample.h
+// stratified sample of the tests for the smoke runs
+//
+
+#ifndef _FTWSAMPLE_H
+#define _FTWSAMPLE_H
+
+#include "ftwtestindex.h"
+
+struct ftw_run_opts_t;
+
+typedef struct ftw_sample_t {
+    unsigned long long   seed;
+    char              ** tests;        // the selected test ids, sorted
+    unsigned int         count;
+    unsigned int         candidates;   // number of the tests, which could be selected
+    unsigned int         window;       // every candidate is chosen once in this many seeds
+    unsigned int         rules;        // number of the rules of the sampled tests
+    unsigned int         total_rules;  // number of the rules of the candidates
+    unsigned int         categories;   // number of the category directories
+} ftw_sample;
+
+ftw_sample * ftw_sample_new(const ftw_testindex * index, const int * candidate, unsigned int target, unsigned long long seed);
+void         ftw_sample_free(ftw_sample * sample);
+int          ftw_sample_contains(const ftw_sample * sample, const char * test);
+double       ftw_sample_size(const char * arg, int * percent);
+ftw_sample * ftw_sample_tests(const struct ftw_run_opts_t * opts, const ftw_testindex * index, unsigned long long seed);
+void         ftw_sample_show(const ftw_sample * sample);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwschedule.c
+// the order of the tests of the time budgeted runs
+//
+// every test of the selected files is parsed before the run, and they are
+// ordered by their tiers: the failed tests of the last run, the tests of
+// the changed rules, the new tests, then the rest by their duration in
+// the last run
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ftwschedule.h"
+#include "ftwrun.h"
+#include "ftwtestutils.h"
+
+static int scheduled_cmp(const void *p1, const void *p2) {
+    const ftw_scheduled_test * a = p1;
+    const ftw_scheduled_test * b = p2;
+
+    if (a->tier != b->tier) {
+        return a->tier - b->tier;
+    }
+    if (a->tier == FTW_TIER_REST && a->cost != b->cost) {
+        return (a->cost > b->cost) ? 1 : -1;
+    }
+    // keep the order of the files and the tests
+    if (a->file != b->file) {
+        return (a->file > b->file) ? 1 : -1;
+    }
+    return a->test - b->test;
+}
+
+// check whether a test belongs to a changed rule, or it fired one in its
+// previous run
+static int test_changed(const ftw_run_opts * opts, const char * test, unsigned int rule_id) {
+    if (opts->affected_ids_count == 0 || opts->affected_all == 1) {
+        return 0;
+    }
+    if (opts->fired != NULL && ftw_fired_db_find(opts->fired, test) != NULL) {
+        return ftw_impact_test_affected(opts->fired, test, rule_id, opts->affected_ids, opts->affected_ids_count);
+    }
+    for (unsigned int i = 0; i < opts->affected_ids_count; i++) {
+        if (opts->affected_ids[i] == rule_id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// the priority of a test by the journal of the last run and the changed rules
+static int test_tier(const ftw_run_opts * opts, const char * test, unsigned int rule_id, int stages_count, unsigned long long * cost) {
+    int failed = 0;
+
+    *cost = 0;
+    for (int si = 0; si < stages_count; si++) {
+        const ftw_journal_entry * prev = (opts->journal != NULL) ? ftw_journal_find(opts->journal, test, si) : NULL;
+        if (prev == NULL) {
+            return (test_changed(opts, test, rule_id) == 1) ? FTW_TIER_CHANGED : FTW_TIER_NEW;
+        }
+        if (prev->result == FTW_TEST_FAIL || prev->result == FTW_TEST_TIMEOUT) {
+            failed = 1;
+        }
+        *cost += prev->duration_ns;
+    }
+    if (failed == 1) {
+        return FTW_TIER_FAILED;
+    }
+    return (test_changed(opts, test, rule_id) == 1) ? FTW_TIER_CHANGED : FTW_TIER_REST;
+}
+
+// run the tests of the given files in the order of their priority until
+// the time budget is used up
+// the list of the files is freed
+// returns the list of the tests, which weren't run
+char ** ftw_schedule_run(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, char ** tests, unsigned test_count,
+                         char *** mismatch_list, int * mismatch_count, unsigned * untested_count) {
+    // every test has to be known for the order
+    ftw_parsed_file    * files     = ftw_run_parse_files(opts, tests, test_count);
+    ftw_scheduled_test * scheduled = NULL;
+    unsigned int         count     = 0;
+    char              ** untested  = NULL;
+
+    for (unsigned i = 0; i < test_count; i++) {
+        const ftwtestcollection * collection = files[i].collection;
+
+        if (collection == NULL || collection->meta.enabled == 0) {
+            continue;
+        }
+        for (int t = 0; t < collection->test_count; t++) {
+            const ftwtest * test = collection->tests[t];
+            char            test_full_id[50];
+
+            if (ftw_run_selected(opts, collection->rule_id, test->test_id, ftw_run_relative_path(opts, tests[i]), collection->meta.tags, collection->meta.tagcnt) == 0) {
+                continue;
+            }
+            scheduled = realloc(scheduled, sizeof(ftw_scheduled_test) * (count + 1));
+            if (scheduled == NULL) {
+                fprintf(stderr, "Error: out of memory!\n");
+                exit(EXIT_FAILURE);
+            }
+            sprintf(test_full_id, "%u-%u", collection->rule_id, test->test_id);
+            scheduled[count].file = i;
+            scheduled[count].test = t;
+            scheduled[count].tier = test_tier(opts, test_full_id, collection->rule_id, test->stages_count, &scheduled[count].cost);
+            count++;
+        }
+    }
+    if (count > 0) {
+        qsort(scheduled, count, sizeof(ftw_scheduled_test), scheduled_cmp);
+    }
+
+    *untested_count = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        const ftwtestcollection * collection = files[scheduled[i].file].collection;
+        const ftwtest           * test       = collection->tests[scheduled[i].test];
+
+        if (monotonic_ns() >= opts->deadline_ns) {
+            char test_full_id[50];
+
+            sprintf(test_full_id, "%u-%u", collection->rule_id, test->test_id);
+            untested = realloc(untested, sizeof(char *) * (*untested_count + 2));
+            if (untested == NULL) {
+                fprintf(stderr, "Error: out of memory!\n");
+                exit(EXIT_FAILURE);
+            }
+            untested[(*untested_count)++] = strdup(test_full_id);
+            untested[*untested_count]     = NULL;
+            continue;
+        }
+        ftw_run_test(engine, engine_full, opts, collection, test, mismatch_list, mismatch_count);
+    }
+
+    ftw_run_free_files(files, test_count);
+    free(scheduled);
+    return untested;
+}
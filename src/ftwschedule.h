@@ -0,0 +1,49 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwschedule.h
+// the order of the tests of the time budgeted runs
+//
+
+#ifndef _FTWSCHEDULE_H
+#define _FTWSCHEDULE_H
+
+#include "engines/engines.h"
+
+struct ftw_run_opts_t;
+
+// priority tiers of the tests of '--time-budget'
+enum {
+    FTW_TIER_FAILED = 0,       // failed in the last run
+    FTW_TIER_CHANGED,          // belongs to or fired a changed rule
+    FTW_TIER_NEW,              // not in the journal
+    FTW_TIER_REST              // ordered by the duration of the last run
+};
+
+// a test of the time budgeted run
+typedef struct ftw_scheduled_test_t {
+    unsigned int         file;         // index in the parsed files
+    int                  test;         // index in the tests of the collection
+    int                  tier;
+    unsigned long long   cost;         // duration of the last run
+} ftw_scheduled_test;
+
+char ** ftw_schedule_run(ftw_engine * engine, ftw_engine * engine_full, const struct ftw_run_opts_t * opts, char ** tests, unsigned test_count,
+                         char *** mismatch_list, int * mismatch_count, unsigned * untested_count);
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwselect.c
+// selection expressions of the tests
+//
+// an expression is a list of terms, separated by commas or spaces, eg:
+//   941*,942100..942190,!942130..942137
+// a test is selected if it matches any term without '!' (or there is no
+// such term), and it doesn't match any term with '!'
+// a selection file contains an expression in one or more lines, the
+// comments start with '#'
+// the directory terms are matched on the path of the test file (relative
+// to the test root), before it's parsed
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#include "ftwselect.h"
+
+// parse a number, which must fill the whole string
+static int select_number(const char * str, size_t len, unsigned int * number) {
+    char   buffer[16];
+    char * end;
+
+    if (len == 0 || len >= sizeof(buffer) || strspn(str, "0123456789") < len) {
+        return -1;
+    }
+    memcpy(buffer, str, len);
+    buffer[len] = '\0';
+    *number = strtoul(buffer, &end, 10);
+    return 0;
+}
+
+// parse a term
+static int select_term(ftw_select_term * term, const char * str) {
+    const char * sep;
+
+    if (*str == '!') {
+        term->exclude = 1;
+        str++;
+    }
+    if (strncmp(str, "dir:", 4) == 0 || strncmp(str, "tag:", 4) == 0) {
+        term->type    = (str[0] == 'd') ? FTW_SELECT_DIR : FTW_SELECT_TAG;
+        term->pattern = strdup(str + 4);
+        return (term->pattern != NULL && term->pattern[0] != '\0') ? 0 : -1;
+    }
+    if (strpbrk(str, "*?[") != NULL) {
+        term->type    = FTW_SELECT_GLOB;
+        term->pattern = strdup(str);
+        return (term->pattern != NULL) ? 0 : -1;
+    }
+    if ((sep = strstr(str, "..")) != NULL) {
+        term->type = FTW_SELECT_RANGE;
+        if (select_number(str, sep - str, &term->from) != 0 || select_number(sep + 2, strlen(sep + 2), &term->to) != 0 || term->from > term->to) {
+            return -1;
+        }
+        return 0;
+    }
+    if ((sep = strchr(str, '-')) != NULL) {
+        term->type = FTW_SELECT_TEST;
+        return (select_number(str, sep - str, &term->from) == 0 && select_number(sep + 1, strlen(sep + 1), &term->test) == 0) ? 0 : -1;
+    }
+    term->type = FTW_SELECT_RULE;
+    return select_number(str, strlen(str), &term->from);
+}
+
+// compile an expression
+// returns NULL on error, and the error message
+ftw_selection * ftw_selection_compile(const char * expr, const char ** error) {
+    ftw_selection * selection = calloc(1, sizeof(ftw_selection));
+    char          * copy      = strdup(expr);
+    char          * saveptr   = NULL;
+
+    *error = NULL;
+    if (selection == NULL || copy == NULL) {
+        free(selection);
+        free(copy);
+        *error = "out of memory";
+        return NULL;
+    }
+    for (char * token = strtok_r(copy, ", \t", &saveptr); token != NULL; token = strtok_r(NULL, ", \t", &saveptr)) {
+        ftw_select_term * terms = realloc(selection->terms, sizeof(ftw_select_term) * (selection->count + 1));
+        if (terms == NULL) {
+            *error = "out of memory";
+            break;
+        }
+        selection->terms = terms;
+        memset(&terms[selection->count], 0, sizeof(ftw_select_term));
+        if (select_term(&terms[selection->count], token) != 0) {
+            free(terms[selection->count].pattern);
+            *error = "invalid term";
+            break;
+        }
+        if (terms[selection->count].exclude == 0) {
+            selection->includes++;
+        }
+        selection->count++;
+    }
+    free(copy);
+    if (*error == NULL && selection->count == 0) {
+        *error = "empty expression";
+    }
+    if (*error != NULL) {
+        ftw_selection_free(selection);
+        return NULL;
+    }
+    return selection;
+}
+
+// read the expression of a selection file without the comments, the
+// lines are joined by spaces
+// returns NULL on error
+char * ftw_selection_read(const char * path) {
+    FILE   * fp       = fopen(path, "r");
+    char   * expr     = NULL;
+    size_t   expr_len = 0;
+    char   * line     = NULL;
+    size_t   linesize = 0;
+    ssize_t  len;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+    expr = calloc(1, 1);
+    while (expr != NULL && (len = getline(&line, &linesize, fp)) != -1) {
+        char * tmp;
+
+        len = strcspn(line, "#\r\n");
+        if ((tmp = realloc(expr, expr_len + len + 2)) == NULL) {
+            free(expr);
+            expr = NULL;
+            break;
+        }
+        expr = tmp;
+        memcpy(expr + expr_len, line, len);
+        expr_len += len;
+        expr[expr_len++] = ' ';
+        expr[expr_len]   = '\0';
+    }
+    free(line);
+    fclose(fp);
+    return expr;
+}
+
+void ftw_selection_free(ftw_selection * selection) {
+    if (selection != NULL) {
+        for (unsigned int i = 0; i < selection->count; i++) {
+            free(selection->terms[i].pattern);
+        }
+        free(selection->terms);
+        free(selection);
+    }
+}
+
+// check whether a directory or the file name (without '.yaml') in the
+// path matches a pattern
+static int select_path_matches(const char * pattern, const char * path) {
+    const char * start = path;
+
+    while (*start != '\0') {
+        size_t len = strcspn(start, "/");
+        char   name[256];
+
+        if (len > 5 && start[len] == '\0' && strcmp(start + len - 5, ".yaml") == 0) {
+            len -= 5;
+        }
+        if (len > 0 && len < sizeof(name)) {
+            memcpy(name, start, len);
+            name[len] = '\0';
+            if (fnmatch(pattern, name, 0) == 0) {
+                return 1;
+            }
+        }
+        start += strcspn(start, "/");
+        start += (*start == '/') ? 1 : 0;
+    }
+    return 0;
+}
+
+// check whether a term matches a test
+// tags can be NULL if they aren't known, then the tag terms don't match
+static int select_term_matches(const ftw_select_term * term, unsigned int rule_id, unsigned int test_id, const char * path, char * const * tags, unsigned int tags_count) {
+    char id[32];
+
+    switch (term->type) {
+        case FTW_SELECT_RULE:
+            return (rule_id == term->from) ? 1 : 0;
+        case FTW_SELECT_RANGE:
+            return (rule_id >= term->from && rule_id <= term->to) ? 1 : 0;
+        case FTW_SELECT_TEST:
+            return (rule_id == term->from && test_id == term->test) ? 1 : 0;
+        case FTW_SELECT_GLOB:
+            if (strchr(term->pattern, '-') != NULL) {
+                snprintf(id, sizeof(id), "%u-%u", rule_id, test_id);
+            }
+            else {
+                snprintf(id, sizeof(id), "%u", rule_id);
+            }
+            return (fnmatch(term->pattern, id, 0) == 0) ? 1 : 0;
+        case FTW_SELECT_DIR:
+            return (path != NULL && select_path_matches(term->pattern, path) == 1) ? 1 : 0;
+        case FTW_SELECT_TAG:
+            for (unsigned int i = 0; tags != NULL && i < tags_count; i++) {
+                if (fnmatch(term->pattern, tags[i], 0) == 0) {
+                    return 1;
+                }
+            }
+            return 0;
+    }
+    return 0;
+}
+
+// check whether a test file can contain a selected test, by its path
+// relative to the test root
+// returns 0 if the file can be left out
+int ftw_selection_match_path(const ftw_selection * selection, const char * path) {
+    int dir_includes = 0;
+    int included     = 0;
+
+    for (unsigned int i = 0; i < selection->count; i++) {
+        const ftw_select_term * term = &selection->terms[i];
+        if (term->type != FTW_SELECT_DIR) {
+            continue;
+        }
+        if (select_path_matches(term->pattern, path) == 1) {
+            if (term->exclude == 1) {
+                return 0;
+            }
+            included = 1;
+        }
+        dir_includes += (term->exclude == 0) ? 1 : 0;
+    }
+    // the other include terms can match only after parsing
+    if (dir_includes > 0 && dir_includes == (int)selection->includes && included == 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// check whether a test is selected
+int ftw_selection_match(const ftw_selection * selection, unsigned int rule_id, unsigned int test_id, const char * path, char * const * tags, unsigned int tags_count) {
+    int included = (selection->includes == 0) ? 1 : 0;
+
+    for (unsigned int i = 0; i < selection->count; i++) {
+        const ftw_select_term * term = &selection->terms[i];
+        if (select_term_matches(term, rule_id, test_id, path, tags, tags_count) == 1) {
+            if (term->exclude == 1) {
+                return 0;
+            }
+            included = 1;
+        }
+    }
+    return included;
+}
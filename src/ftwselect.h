@@ -0,0 +1,56 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwselect.h
+// selection expressions of the tests
+//
+
+#ifndef _FTWSELECT_H
+#define _FTWSELECT_H
+
+enum {
+    FTW_SELECT_RULE = 0,   // 942100
+    FTW_SELECT_RANGE,      // 942100..942190
+    FTW_SELECT_TEST,       // 942100-1
+    FTW_SELECT_GLOB,       // 9421*, 942100-?, glob on the rule id or the test id
+    FTW_SELECT_DIR,        // dir:REQUEST-942-*, glob on a directory or file name
+    FTW_SELECT_TAG         // tag:attack-sqli, glob on the meta.tags
+};
+
+typedef struct ftw_select_term_t {
+    int             type;
+    int             exclude;
+    unsigned int    from;          // rule id, or the first of a range
+    unsigned int    to;
+    unsigned int    test;
+    char          * pattern;
+} ftw_select_term;
+
+typedef struct ftw_selection_t {
+    ftw_select_term * terms;
+    unsigned int      count;
+    unsigned int      includes;    // number of the terms without '!'
+} ftw_selection;
+
+ftw_selection * ftw_selection_compile(const char * expr, const char ** error);
+char          * ftw_selection_read(const char * path);
+void            ftw_selection_free(ftw_selection * selection);
+int             ftw_selection_match_path(const ftw_selection * selection, const char * path);
+int             ftw_selection_match(const ftw_selection * selection, unsigned int rule_id, unsigned int test_id, const char * path, char * const * tags, unsigned int tags_count);
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwsoak.c
+// soak mode: memory growth of the tests over repeated runs
+//
+// the selected tests run in the same order in every iteration, the heap
+// growth of every run of a test is recorded, and the resident set size
+// and the heap are sampled after every iteration
+// a test leaks if the least squares slope of its cumulated growth is at
+// least the threshold; the first iteration is left out, it fills the
+// caches of the engine
+// only the results of the last iteration are shown
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ftwsoak.h"
+#include "ftwrun.h"
+#include "ftwrunner.h"
+#include "ftwtestutils.h"
+
+ftw_soak * ftw_soak_new(unsigned int iterations) {
+    ftw_soak * soak = calloc(1, sizeof(ftw_soak));
+
+    if (soak == NULL) {
+        return NULL;
+    }
+    soak->iterations = iterations;
+    soak->rss        = calloc(iterations, sizeof(long long));
+    soak->heap       = calloc(iterations, sizeof(long long));
+    if (soak->rss == NULL || soak->heap == NULL) {
+        ftw_soak_free(soak);
+        return NULL;
+    }
+    return soak;
+}
+
+// add the growth of the run of a test at a position of the current iteration
+void ftw_soak_add(ftw_soak * soak, unsigned int position, const char * test, long long growth) {
+    if (position >= soak->count) {
+        ftw_soak_test * tests = realloc(soak->tests, sizeof(ftw_soak_test) * (position + 1));
+        if (tests == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        soak->tests = tests;
+        snprintf(soak->tests[position].test, sizeof(soak->tests[position].test), "%s", test);
+        if ((soak->tests[position].growth = calloc(soak->iterations, sizeof(long long))) == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        soak->count = position + 1;
+    }
+    soak->tests[position].growth[soak->iteration] = growth;
+}
+
+// the resident set size of the process, or -1
+static long long soak_rss(void) {
+    long long pages = -1;
+    FILE    * fp    = fopen("/proc/self/statm", "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+    if (fscanf(fp, "%*s %lld", &pages) != 1) {
+        pages = -1;
+    }
+    fclose(fp);
+    return (pages < 0) ? -1 : pages * sysconf(_SC_PAGESIZE);
+}
+
+// sample the memory after the current iteration, and step to the next one
+void ftw_soak_sample(ftw_soak * soak, long long heap) {
+    soak->rss[soak->iteration]  = soak_rss();
+    soak->heap[soak->iteration] = heap;
+    printf("SOAK ITERATION %u/%u: RSS %lld KiB, heap %lld KiB\n", soak->iteration + 1, soak->iterations,
+        soak->rss[soak->iteration] / 1024, heap / 1024);
+    soak->iteration++;
+}
+
+// least squares slope of the values from the second one
+static double soak_slope(const long long * values, unsigned int count) {
+    double mean_x = 0.0;
+    double mean_y = 0.0;
+    double sxy    = 0.0;
+    double sxx    = 0.0;
+    unsigned int n = count - 1;
+
+    if (count < 3) {
+        return 0.0;
+    }
+    for (unsigned int i = 1; i < count; i++) {
+        mean_x += i;
+        mean_y += values[i];
+    }
+    mean_x /= n;
+    mean_y /= n;
+    for (unsigned int i = 1; i < count; i++) {
+        sxy += (i - mean_x) * (values[i] - mean_y);
+        sxx += (i - mean_x) * (i - mean_x);
+    }
+    return (sxx > 0.0) ? sxy / sxx : 0.0;
+}
+
+// show the growth of the process, and the tests which leak
+void ftw_soak_show(const ftw_soak * soak, long long threshold) {
+    long long  * cumulated = calloc(soak->iterations, sizeof(long long));
+    unsigned int leaking   = 0;
+
+    if (cumulated == NULL) {
+        return;
+    }
+    printf("SOAK ITERATIONS:        %u\n", soak->iteration);
+    printf("RSS GROWTH:             %.1f bytes/iteration\n", soak_slope(soak->rss, soak->iteration));
+    printf("HEAP GROWTH:            %.1f bytes/iteration\n", soak_slope(soak->heap, soak->iteration));
+    printf("LEAKING TESTS (>= %lld bytes/iteration):\n", threshold);
+    for (unsigned int t = 0; t < soak->count; t++) {
+        double slope;
+
+        for (unsigned int i = 0; i < soak->iteration; i++) {
+            cumulated[i] = soak->tests[t].growth[i] + ((i > 0) ? cumulated[i - 1] : 0);
+        }
+        slope = soak_slope(cumulated, soak->iteration);
+        if (slope >= threshold) {
+            printf("%-23s %.1f bytes/iteration\n", soak->tests[t].test, slope);
+            leaking++;
+        }
+    }
+    if (leaking == 0) {
+        printf("none\n");
+    }
+    printf("===============================\n");
+    free(cumulated);
+}
+
+void ftw_soak_free(ftw_soak * soak) {
+    if (soak != NULL) {
+        for (unsigned int t = 0; t < soak->count; t++) {
+            free(soak->tests[t].growth);
+        }
+        free(soak->tests);
+        free(soak->rss);
+        free(soak->heap);
+        free(soak);
+    }
+}
+
+// run the tests of the given files '--soak' times, and record the heap
+// growth of every run
+// only the results of the last iteration are shown and counted
+// the list of the files is freed
+void ftw_soak_run(ftw_engine * engine, ftw_engine * engine_full, const ftw_run_opts * opts, char ** tests, unsigned test_count,
+                  char *** mismatch_list, int * mismatch_count) {
+    ftw_parsed_file * files = ftw_run_parse_files(opts, tests, test_count);
+
+    for (unsigned int it = 0; it < opts->soak->iterations; it++) {
+        unsigned int        position = 0;
+        char             ** scratch_list  = NULL;
+        int                 scratch_count = 0;
+        int                 last = (it + 1 == opts->soak->iterations) ? 1 : 0;
+
+        engine->quiet = (last == 1) ? 0 : 1;
+        for (unsigned i = 0; i < test_count; i++) {
+            const ftwtestcollection * collection = files[i].collection;
+
+            if (collection == NULL || collection->meta.enabled == 0) {
+                continue;
+            }
+            for (int t = 0; t < collection->test_count; t++) {
+                const ftwtest      * test = collection->tests[t];
+                char                 test_full_id[50];
+
+                if (ftw_run_selected(opts, collection->rule_id, test->test_id, ftw_run_relative_path(opts, files[i].path), collection->meta.tags, collection->meta.tagcnt) == 0) {
+                    continue;
+                }
+                sprintf(test_full_id, "%u-%u", collection->rule_id, test->test_id);
+                // only the transactions of the engine are measured, not the
+                // lists and the reports of the runner
+                engine->heap_growth = 0;
+                ftw_run_test(engine, engine_full, opts, collection, test, (last == 1) ? mismatch_list : &scratch_list, (last == 1) ? mismatch_count : &scratch_count);
+                ftw_soak_add(opts->soak, position++, test_full_id, engine->heap_growth);
+            }
+        }
+        FTW_FREE_STRINGLIST(scratch_list);
+        logCbClearLog();
+        ftw_soak_sample(opts->soak, ftw_alloc_heap());
+        if (last == 0) {
+            ftw_engine_reset(engine);
+            if (engine_full != NULL) {
+                ftw_engine_reset(engine_full);
+            }
+        }
+    }
+    engine->quiet = 0;
+    ftw_run_free_files(files, test_count);
+}
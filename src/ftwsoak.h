@@ -0,0 +1,55 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwsoak.h
+// soak mode: memory growth of the tests over repeated runs
+//
+
+#ifndef _FTWSOAK_H
+#define _FTWSOAK_H
+
+#include "engines/engines.h"
+
+struct ftw_run_opts_t;
+
+// the default growth of a leaking test in bytes per iteration
+#define FTW_SOAK_THRESHOLD 64
+
+typedef struct ftw_soak_test_t {
+    char                 test[50];
+    long long          * growth;       // the heap growth of the runs of the test
+} ftw_soak_test;
+
+typedef struct ftw_soak_t {
+    unsigned int         iterations;
+    unsigned int         iteration;    // the current one
+    ftw_soak_test      * tests;        // in the order of the runs
+    unsigned int         count;
+    long long          * rss;          // after the iterations, in bytes
+    long long          * heap;         // the heap in use after the iterations
+} ftw_soak;
+
+ftw_soak * ftw_soak_new(unsigned int iterations);
+void       ftw_soak_add(ftw_soak * soak, unsigned int position, const char * test, long long growth);
+void       ftw_soak_sample(ftw_soak * soak, long long heap);
+void       ftw_soak_show(const ftw_soak * soak, long long threshold);
+void       ftw_soak_free(ftw_soak * soak);
+void       ftw_soak_run(ftw_engine * engine, ftw_engine * engine_full, const struct ftw_run_opts_t * opts, char ** tests, unsigned test_count,
+                        char *** mismatch_list, int * mismatch_count);
+
+#endif
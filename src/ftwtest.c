@@ -42,6 +42,7 @@
 //
 
 #include <time.h>
+#include <strings.h>
 #include "ftwtest.h"
 #include "yamlapi.h"
 #include "ftwrunner.h"
@@ -114,7 +115,9 @@ void ftwoutputlog_free(ftw_log **log) {
 void ftwoutput_free(ftw_output *output) {
     FTW_FREE_STRING(output->response_contains);
     FTW_FREE_STRING(output->log_contains);
+    FTW_FREE_STRING(output->log_contains_literal);
     FTW_FREE_STRING(output->no_log_contains);
+    FTW_FREE_STRING(output->no_log_contains_literal);
     ftwoutputlog_free(&output->log);
     free(output);
 }
@@ -166,12 +169,17 @@ void ftwtestcollection_free(ftwtestcollection * collection) {
             ftwtest_free(collection->tests[t]);
         }
         free(collection->tests);
+        for(int t = 0; t < collection->meta.tagcnt; t++) {
+            free(collection->meta.tags[t]);
+        }
+        free(collection->meta.tags);
     }
     free(collection);
 }
 
 #define FTWOUTPUT_VAR(v) { \
     if (yaml_item_get_value_by_key(youtput, (const char *)#v, &ytitem) == YAML_KEYSEARCH_FOUND) { \
+        FTW_FREE_STRING(output->v); \
         output->v = strdup(ytitem->value.sval); \
         ytitem = NULL; \
     } \
@@ -280,6 +288,17 @@ ftw_output * ftwoutput_new(yaml_item * youtput) {
     FTWOUTPUT_VAR(log_contains);
     FTWOUTPUT_VAR(no_log_contains);
 
+    // classify the patterns once, at load time: plain literals
+    // don't need to go through PCRE2
+    output->log_contains_literal    = NULL;
+    output->no_log_contains_literal = NULL;
+    if (output->log_contains != NULL) {
+        output->log_contains_literal = literal_pattern(output->log_contains);
+    }
+    if (output->no_log_contains != NULL) {
+        output->no_log_contains_literal = literal_pattern(output->no_log_contains);
+    }
+
     return output;
 }
 
@@ -534,6 +553,67 @@ ftw_input * ftwinput_new(yaml_item * yinput) {
     return input;
 }
 
+// the size of the request of a stage: the uri, the headers and the data
+unsigned long ftw_stage_payload(const ftw_stage * stage) {
+    const ftw_input * input   = stage->input;
+    unsigned long     payload = 0;
+
+    if (input == NULL) {
+        return 0;
+    }
+    payload += (input->uri != NULL) ? strlen(input->uri) : 0;
+    payload += (input->data != NULL) ? strlen(input->data) : 0;
+    for (unsigned int hi = 0; hi < input->headers_len; hi++) {
+        payload += strlen(input->headers[hi]->name) + strlen(input->headers[hi]->value);
+    }
+    return payload;
+}
+
+// the reason why a stage can't be run, or NULL
+const char * ftw_stage_skip_reason(const ftw_stage * stage) {
+    const ftw_input  * input  = stage->input;
+    const ftw_output * output = stage->output;
+
+    if (input->encoded_request != NULL && strlen(input->encoded_request) > 0) {
+        return "'encoded_request' not implemented yet";
+    }
+    if (input->raw_request != NULL) {
+        return "'raw_request' not implemented yet";
+    }
+    if (output->expect_error != 0) {
+        return "'expect_error' is HTTP server specific - test skipped";
+    }
+    if (output->status != 0) {
+        return "'status' is HTTP server specific - test skipped";
+    }
+    if (input->version != NULL && (strlen(input->version) == 0 || strncmp(input->version, "HTTP", 4) != 0)) {
+        return "Only HTTP protocol allowed";
+    }
+    if ((output->log_contains == NULL          || strlen(output->log_contains) == 0) &&
+        (output->no_log_contains == NULL       || strlen(output->no_log_contains) == 0) &&
+        (output->log == NULL ||
+        (((output->log->expect_ids_len == 0)    && (output->log->no_expect_ids_len == 0)) &&
+        ((output->log->match_regex == NULL)    || (strlen(output->log->match_regex) == 0)) &&
+        ((output->log->no_match_regex == NULL) || (strlen(output->log->no_match_regex) == 0))))) {
+        return "No valid test output";
+    }
+    return NULL;
+}
+
+// the date of the backend responses
+// it's pinned at the first response of the run, so the identical requests
+// get identical responses
+static const char * ftw_response_date(void) {
+    static char date[40] = "";
+
+    if (date[0] == '\0') {
+        time_t timeraw;
+        time(&timeraw);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&timeraw));
+    }
+    return date;
+}
+
 // create a new response
 // this is not part of the yaml structure, but necessary for the test
 ftw_stage_response *ftw_stage_response_new(yaml_item * root) {
@@ -564,8 +644,10 @@ ftwtestcollection *ftwtestcollection_new(yaml_item * yroot, unsigned int rule_id
     }
     collection->tests = calloc(1, sizeof(ftwtest *));
     collection->test_count = 0;
+    collection->meta.tags = NULL;
+    collection->meta.tagcnt = 0;
 
-    // meta needs only to read the meta.enabled value
+    // meta needs only to read the meta.enabled and the meta.tags values
     if (yaml_item_get_value_by_key(yroot, (const char *)"meta", &ytitem1) != YAML_KEYSEARCH_FOUND) {
         printf("Key not exists: meta\n");
         ftwtestcollection_free(collection);
@@ -579,6 +661,18 @@ ftwtestcollection *ftwtestcollection_new(yaml_item * yroot, unsigned int rule_id
         else {
             collection->meta.enabled = yaml_item_value_as_bool(ytitem2);
         }
+        if (yaml_item_get_value_by_key(ytitem1, (const char *)"tags", &ytitem2) == YAML_KEYSEARCH_FOUND && ytitem2->type == YAML_VALTYPE_LIST) {
+            collection->meta.tags = calloc(ytitem2->value.list->length + 1, sizeof(char *));
+            if (collection->meta.tags == NULL) {
+                ftwtestcollection_free(collection);
+                return NULL;
+            }
+            for (int i = 0; i < ytitem2->value.list->length; i++) {
+                if (ytitem2->value.list->list[i]->type == YAML_VALTYPE_STRING) {
+                    collection->meta.tags[collection->meta.tagcnt++] = strdup(ytitem2->value.list->list[i]->value.sval);
+                }
+            }
+        }
         // other fields are not used
         // author, ...
     }
@@ -723,12 +817,7 @@ ftwtestcollection *ftwtestcollection_new(yaml_item * yroot, unsigned int rule_id
                                                     return NULL;
                                                 }
                                                 stage->response->response_code = 200;
-                                                time_t timeraw;
-                                                const struct tm * timeinfo;
-                                                time(&timeraw);
-                                                timeinfo = gmtime(&timeraw);
-                                                stage->response->response_date = calloc(40, sizeof(char));
-                                                strftime(stage->response->response_date, 40, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+                                                stage->response->response_date = strdup(ftw_response_date());
                                                 if (strcmp(stage->input->uri, "/reflect") == 0) {
                                                     stage->response->response_body = (unsigned char*)strdup(stage->input->data);
                                                     stage->response->response_len = strlen((char*)stage->response->response_body);
@@ -760,3 +849,123 @@ ftwtestcollection *ftwtestcollection_new(yaml_item * yroot, unsigned int rule_id
     return collection;
 }
 
+
+// hash of a string, NULL differs from the empty string
+#define FTW_HASH_STR(s, hash) (((s) == NULL) ? hash_fnv1a("", 0, (hash) + 1) : hash_fnv1a((s), strlen(s) + 1, (hash)))
+#define FTW_HASH_VAL(v, hash) hash_fnv1a(&(v), sizeof(v), (hash))
+
+// hash of the normalized input of a stage (after the header autocompletion
+// and the data encoding)
+// the X-CRS-Test header is left out, the engines set it to the test title
+unsigned long long ftwinput_hash(const ftw_input * input, unsigned long long hash) {
+    hash = FTW_HASH_STR(input->dest_addr, hash);
+    hash = FTW_HASH_VAL(input->port, hash);
+    hash = FTW_HASH_STR(input->method, hash);
+    for (unsigned int i = 0; i < input->headers_len; i++) {
+        if (strcasecmp(input->headers[i]->name, "X-CRS-Test") == 0) {
+            continue;
+        }
+        hash = FTW_HASH_STR(input->headers[i]->name, hash);
+        hash = FTW_HASH_STR(input->headers[i]->value, hash);
+    }
+    hash = FTW_HASH_STR(input->protocol, hash);
+    hash = FTW_HASH_STR(input->uri, hash);
+    hash = FTW_HASH_STR(input->version, hash);
+    hash = FTW_HASH_STR(input->data, hash);
+    hash = FTW_HASH_STR(input->encoded_request, hash);
+    hash = FTW_HASH_STR(input->raw_request, hash);
+    hash = FTW_HASH_STR(input->content_type, hash);
+    return hash;
+}
+
+// hash of the expected output of a stage
+unsigned long long ftwoutput_hash(const ftw_output * output, unsigned long long hash) {
+    hash = FTW_HASH_VAL(output->status, hash);
+    hash = FTW_HASH_STR(output->response_contains, hash);
+    hash = FTW_HASH_STR(output->log_contains, hash);
+    hash = FTW_HASH_STR(output->no_log_contains, hash);
+    hash = FTW_HASH_VAL(output->expect_error, hash);
+    if (output->log != NULL) {
+        hash = hash_fnv1a(output->log->expect_ids, sizeof(unsigned int) * output->log->expect_ids_len, hash + 1);
+        hash = hash_fnv1a(output->log->no_expect_ids, sizeof(unsigned int) * output->log->no_expect_ids_len, hash + 2);
+        hash = FTW_HASH_STR(output->log->match_regex, hash);
+        hash = FTW_HASH_STR(output->log->no_match_regex, hash);
+    }
+    return hash;
+}
+
+// hash of the request of a stage: the input and the response of the
+// backend, except its date
+unsigned long long ftw_request_hash(const ftw_stage * stage) {
+    unsigned long long hash = FNV1A_INIT;
+
+    hash = ftwinput_hash(stage->input, hash);
+    if (stage->response != NULL) {
+        hash = FTW_HASH_VAL(stage->response->response_code, hash);
+        hash = hash_fnv1a(stage->response->response_body, (stage->response->response_body != NULL) ? stage->response->response_len : 0, hash);
+        hash = FTW_HASH_STR((const char *)stage->response->response_content_type, hash);
+    }
+    return hash;
+}
+
+// the request buffer grows by appending the fields, a string is stored with
+// its length, NULL differs from the empty string
+static void ftw_request_append(unsigned char ** buf, size_t * len, const void * data, size_t data_len) {
+    unsigned char * grown = realloc(*buf, *len + data_len);
+    if (grown == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(grown + *len, data, data_len);
+    *buf  = grown;
+    *len += data_len;
+}
+
+static void ftw_request_append_str(unsigned char ** buf, size_t * len, const void * s, size_t s_len) {
+    unsigned char present = (s != NULL) ? 1 : 0;
+    ftw_request_append(buf, len, &present, sizeof(present));
+    if (s != NULL) {
+        ftw_request_append(buf, len, &s_len, sizeof(s_len));
+        ftw_request_append(buf, len, s, s_len);
+    }
+}
+
+#define FTW_APPEND_STR(s) ftw_request_append_str(&buf, len, (s), ((s) != NULL) ? strlen(s) : 0)
+#define FTW_APPEND_VAL(v) ftw_request_append(&buf, len, &(v), sizeof(v))
+
+// the request of a stage as bytes, the same fields as ftw_request_hash
+// the caller frees the buffer
+unsigned char * ftw_request_serialize(const ftw_stage * stage, size_t * len) {
+    const ftw_input * input = stage->input;
+    unsigned char   * buf   = NULL;
+
+    *len = 0;
+    FTW_APPEND_STR(input->dest_addr);
+    FTW_APPEND_VAL(input->port);
+    FTW_APPEND_STR(input->method);
+    for (unsigned int i = 0; i < input->headers_len; i++) {
+        if (strcasecmp(input->headers[i]->name, "X-CRS-Test") == 0) {
+            continue;
+        }
+        FTW_APPEND_STR(input->headers[i]->name);
+        FTW_APPEND_STR(input->headers[i]->value);
+    }
+    FTW_APPEND_STR(input->protocol);
+    FTW_APPEND_STR(input->uri);
+    FTW_APPEND_STR(input->version);
+    FTW_APPEND_STR(input->data);
+    FTW_APPEND_STR(input->encoded_request);
+    FTW_APPEND_STR(input->raw_request);
+    FTW_APPEND_STR(input->content_type);
+    if (stage->response != NULL) {
+        FTW_APPEND_VAL(stage->response->response_code);
+        ftw_request_append_str(&buf, len, stage->response->response_body, (stage->response->response_body != NULL) ? stage->response->response_len : 0);
+        FTW_APPEND_STR((const char *)stage->response->response_content_type);
+    }
+    return buf;
+}
+
+// hash of a stage: the request and the expected output
+unsigned long long ftw_stage_hash(const ftw_stage * stage) {
+    return ftwoutput_hash(stage->output, ftw_request_hash(stage));
+}
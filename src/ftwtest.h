@@ -69,7 +69,9 @@ typedef struct ftw_output_t {
     unsigned int  status;
     char         *response_contains;
     char         *log_contains;
+    char         *log_contains_literal;    // NULL if log_contains is a regex
     char         *no_log_contains;
+    char         *no_log_contains_literal; // NULL if no_log_contains is a regex
     ftw_log      *log;
     ybool         expect_error;
     ybool         retry_once;
@@ -103,8 +105,8 @@ typedef struct {
     //char       * name;
     //char       * description;
     //char       * version;
-    //char      ** tags;
-    //unsigned int tagcnt;
+    char        ** tags;
+    unsigned int   tagcnt;
 } ftwmeta;
 
 typedef struct {
@@ -117,4 +119,12 @@ typedef struct {
 ftwtestcollection *ftwtestcollection_new(yaml_item * yroot, unsigned int rule_id, unsigned int test_id);
 void               ftwtestcollection_free(ftwtestcollection * collection);
 
+unsigned long long ftwinput_hash(const ftw_input * input, unsigned long long hash);
+unsigned long long ftwoutput_hash(const ftw_output * output, unsigned long long hash);
+const char *       ftw_stage_skip_reason(const ftw_stage * stage);
+unsigned long      ftw_stage_payload(const ftw_stage * stage);
+unsigned long long ftw_request_hash(const ftw_stage * stage);
+unsigned char *    ftw_request_serialize(const ftw_stage * stage, size_t * len);
+unsigned long long ftw_stage_hash(const ftw_stage * stage);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,376 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwtestindex.c
+// prebuilt index of the test files for the listing and the selection
+//
+// the index is a text file with a header line with the test root, a line
+// for every test file, and a line for every test after its file:
+//   F <mtime> <size> <path>
+//   G <tag> <tag> ...
+//   T <rule id> <test id> <stages> <enabled> <payload> <skip reason or ->
+// a file is parsed again only if its modification time or size changed
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "ftwtestindex.h"
+#include "ftwrun.h"
+#include "ftwtest.h"
+#include "yamlapi.h"
+
+// modification time of a file in nanoseconds
+static long long testindex_mtime(const struct stat * st) {
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + (long long)st->st_mtim.tv_nsec;
+}
+
+static int testindex_pathcmp(const void *p1, const void *p2) {
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+// add an empty file to the index
+static ftw_indexed_file * testindex_add_file(ftw_testindex * index, const char * path, long long mtime, long long size) {
+    ftw_indexed_file * files = realloc(index->files, sizeof(ftw_indexed_file) * (index->files_count + 1));
+    if (files == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    index->files = files;
+    files = &index->files[index->files_count++];
+    files->path        = strdup(path);
+    files->mtime       = mtime;
+    files->size        = size;
+    files->first_test  = index->tests_count;
+    files->tests_count = 0;
+    files->tags        = NULL;
+    files->tags_count  = 0;
+    return files;
+}
+
+// add a tag to the last file of the index
+static void testindex_add_tag(ftw_testindex * index, const char * tag) {
+    ftw_indexed_file * file = &index->files[index->files_count - 1];
+    char            ** tags = realloc(file->tags, sizeof(char *) * (file->tags_count + 1));
+
+    if (tags == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    file->tags = tags;
+    file->tags[file->tags_count++] = strdup(tag);
+}
+
+// add a test to the last file of the index
+static void testindex_add_test(ftw_testindex * index, const ftw_indexed_test * test) {
+    ftw_indexed_test * tests = realloc(index->tests, sizeof(ftw_indexed_test) * (index->tests_count + 1));
+    if (tests == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    index->tests = tests;
+    index->tests[index->tests_count] = *test;
+    index->tests[index->tests_count].file = index->files_count - 1;
+    index->tests[index->tests_count].skip = (test->skip != NULL) ? strdup(test->skip) : NULL;
+    index->tests_count++;
+    index->files[index->files_count - 1].tests_count++;
+}
+
+// parse a test file, and add its tests to the last file of the index
+static void testindex_parse_file(ftw_testindex * index, const char * path) {
+    yaml_item         * yroot = parse_yaml(path);
+    ftwtestcollection * collection;
+
+    if (yroot == NULL) {
+        fprintf(stderr, "Error: failed to parse YAML file: %s\n", path);
+        return;
+    }
+    collection = ftwtestcollection_new(yroot, 0, 0);
+    if (collection == NULL) {
+        fprintf(stderr, "Error parsing file %s!\n", path);
+        yaml_item_free(yroot);
+        return;
+    }
+    for (unsigned int i = 0; i < collection->meta.tagcnt; i++) {
+        testindex_add_tag(index, collection->meta.tags[i]);
+    }
+    for (unsigned int t = 0; t < collection->test_count; t++) {
+        const ftwtest    * test = collection->tests[t];
+        ftw_indexed_test   item = {0};
+
+        item.rule_id      = collection->rule_id;
+        item.test_id      = test->test_id;
+        item.stages_count = test->stages_count;
+        item.enabled      = (collection->meta.enabled) ? 1 : 0;
+        for (unsigned int si = 0; si < test->stages_count; si++) {
+            if (test->stages[si]->input == NULL) {
+                continue;
+            }
+            item.payload += ftw_stage_payload(test->stages[si]);
+            if (item.skip == NULL) {
+                item.skip = (char *)ftw_stage_skip_reason(test->stages[si]);
+            }
+        }
+        testindex_add_test(index, &item);
+    }
+    ftwtestcollection_free(collection);
+    yaml_item_free(yroot);
+}
+
+// load an index file
+// returns NULL if the file is missing, or it belongs to another test root
+ftw_testindex * ftw_testindex_load(const char * path, const char * root) {
+    ftw_testindex * index;
+    FILE          * fp;
+    char          * line     = NULL;
+    size_t          linesize = 0;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        return NULL;
+    }
+    if (getline(&line, &linesize, fp) == -1) {
+        free(line);
+        fclose(fp);
+        return NULL;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if (strncmp(line, FTW_TESTINDEX_MAGIC " ", strlen(FTW_TESTINDEX_MAGIC) + 1) != 0
+        || strcmp(line + strlen(FTW_TESTINDEX_MAGIC) + 1, root) != 0
+        || (index = calloc(1, sizeof(ftw_testindex))) == NULL) {
+        free(line);
+        fclose(fp);
+        return NULL;
+    }
+    index->root = strdup(root);
+    while (getline(&line, &linesize, fp) != -1) {
+        ftw_indexed_test test = {0};
+        long long        mtime, size;
+        int              n = 0;
+
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "F %lld %lld %n", &mtime, &size, &n) == 2 && n > 0) {
+            testindex_add_file(index, line + n, mtime, size);
+        }
+        else if (index->files_count > 0 && strncmp(line, "G ", 2) == 0) {
+            char * saveptr = NULL;
+            for (char * tag = strtok_r(line + 2, " ", &saveptr); tag != NULL; tag = strtok_r(NULL, " ", &saveptr)) {
+                testindex_add_tag(index, tag);
+            }
+        }
+        else if (index->files_count > 0
+            && sscanf(line, "T %u %u %u %d %lu %n", &test.rule_id, &test.test_id, &test.stages_count, &test.enabled, &test.payload, &n) == 5 && n > 0) {
+            test.skip = (strcmp(line + n, "-") == 0) ? NULL : line + n;
+            testindex_add_test(index, &test);
+        }
+    }
+    free(line);
+    fclose(fp);
+    return index;
+}
+
+// create an index of the test files
+// the unchanged files are taken from the old index, if it's given
+ftw_testindex * ftw_testindex_update(const ftw_testindex * index, const char * root, char ** paths, unsigned int paths_count) {
+    ftw_testindex * updated = calloc(1, sizeof(ftw_testindex));
+    char         ** sorted  = malloc(sizeof(char *) * (paths_count + 1));
+
+    if (updated == NULL || sorted == NULL) {
+        free(updated);
+        free(sorted);
+        return NULL;
+    }
+    updated->root = strdup(root);
+    memcpy(sorted, paths, sizeof(char *) * paths_count);
+    qsort(sorted, paths_count, sizeof(char *), testindex_pathcmp);
+    for (unsigned int i = 0; i < paths_count; i++) {
+        struct stat st;
+        int         old = (index != NULL) ? ftw_testindex_find_file(index, sorted[i]) : -1;
+
+        if (stat(sorted[i], &st) != 0) {
+            continue;
+        }
+        testindex_add_file(updated, sorted[i], testindex_mtime(&st), (long long)st.st_size);
+        if (old >= 0 && ftw_testindex_is_fresh(index, old) == 1) {
+            for (unsigned int t = 0; t < index->files[old].tags_count; t++) {
+                testindex_add_tag(updated, index->files[old].tags[t]);
+            }
+            for (unsigned int t = 0; t < index->files[old].tests_count; t++) {
+                testindex_add_test(updated, &index->tests[index->files[old].first_test + t]);
+            }
+        }
+        else {
+            testindex_parse_file(updated, sorted[i]);
+            updated->parsed++;
+        }
+    }
+    free(sorted);
+    return updated;
+}
+
+void ftw_testindex_free(ftw_testindex * index) {
+    if (index != NULL) {
+        for (unsigned int i = 0; i < index->files_count; i++) {
+            free(index->files[i].path);
+            for (unsigned int t = 0; t < index->files[i].tags_count; t++) {
+                free(index->files[i].tags[t]);
+            }
+            free(index->files[i].tags);
+        }
+        for (unsigned int i = 0; i < index->tests_count; i++) {
+            free(index->tests[i].skip);
+        }
+        free(index->files);
+        free(index->tests);
+        free(index->root);
+        free(index);
+    }
+}
+
+// write the index into a temporary file, and rename it to the index file
+// returns 0, or -1 on error
+int ftw_testindex_save(const ftw_testindex * index, const char * path) {
+    char   tmppath[PATH_MAX];
+    FILE * fp;
+    int    rc = 0;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    if ((fp = fopen(tmppath, "w")) == NULL) {
+        return -1;
+    }
+    fprintf(fp, "%s %s\n", FTW_TESTINDEX_MAGIC, index->root);
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        const ftw_indexed_file * file = &index->files[i];
+        fprintf(fp, "F %lld %lld %s\n", file->mtime, file->size, file->path);
+        if (file->tags_count > 0) {
+            fprintf(fp, "G");
+            for (unsigned int t = 0; t < file->tags_count; t++) {
+                fprintf(fp, " %s", file->tags[t]);
+            }
+            fprintf(fp, "\n");
+        }
+        for (unsigned int t = file->first_test; t < file->first_test + file->tests_count; t++) {
+            const ftw_indexed_test * test = &index->tests[t];
+            fprintf(fp, "T %u %u %u %d %lu %s\n", test->rule_id, test->test_id, test->stages_count, test->enabled, test->payload,
+                (test->skip != NULL) ? test->skip : "-");
+        }
+    }
+    if (fclose(fp) != 0 || rename(tmppath, path) != 0) {
+        remove(tmppath);
+        rc = -1;
+    }
+    return rc;
+}
+
+// find a test file
+// returns its index, or -1
+int ftw_testindex_find_file(const ftw_testindex * index, const char * path) {
+    unsigned int first = 0;
+    unsigned int last  = index->files_count;
+
+    while (first < last) {
+        unsigned int middle = (first + last) / 2;
+        int          cmp    = strcmp(index->files[middle].path, path);
+        if (cmp == 0) {
+            return middle;
+        }
+        if (cmp < 0) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return -1;
+}
+
+// check whether a file is unchanged since it was indexed
+int ftw_testindex_is_fresh(const ftw_testindex * index, int file) {
+    struct stat st;
+
+    if (stat(index->files[file].path, &st) != 0) {
+        return 0;
+    }
+    return (testindex_mtime(&st) == index->files[file].mtime && (long long)st.st_size == index->files[file].size) ? 1 : 0;
+}
+
+// list the tests selected by '-r', '-t' and '-s' from the test index
+void ftw_testindex_list(const ftw_run_opts * opts, const ftw_testindex * index) {
+    unsigned count    = 0;
+    unsigned disabled = 0;
+    unsigned skipped  = 0;
+
+    for (unsigned int i = 0; i < index->tests_count; i++) {
+        const ftw_indexed_test * test = &index->tests[i];
+        const ftw_indexed_file * file = &index->files[test->file];
+        const char             * path = ftw_run_relative_path(opts, file->path);
+        char                     test_full_id[50];
+
+        if (ftw_run_selected(opts, test->rule_id, test->test_id, path, file->tags, file->tags_count) == 0) {
+            continue;
+        }
+        sprintf(test_full_id, "%u-%u", test->rule_id, test->test_id);
+        printf("%-12s stages: %-3u payload: %-6lu %s", test_full_id, test->stages_count, test->payload, path);
+        if (test->enabled == 0) {
+            printf(" DISABLED");
+            disabled++;
+        }
+        else if (test->skip != NULL) {
+            printf(" SKIPPED: %s", test->skip);
+            skipped++;
+        }
+        printf("\n");
+        count++;
+    }
+    printf("===============================\n");
+    printf("TESTS:                  %u\n", count);
+    printf("DISABLED:               %u\n", disabled);
+    printf("SKIPPED:                %u\n", skipped);
+    printf("===============================\n");
+}
+
+// drop the test files without the test selected by '-r', '-t' and '-s'
+// only the unchanged files of the test index are dropped
+void ftw_testindex_select_files(const ftw_run_opts * opts, const char * index_path, char ** tests, unsigned * test_count) {
+    ftw_testindex * index = ftw_testindex_load(index_path, opts->ftwtest_root);
+    unsigned        kept  = 0;
+
+    if (index == NULL) {
+        return;
+    }
+    for (unsigned i = 0; i < *test_count; i++) {
+        int file = ftw_testindex_find_file(index, tests[i]);
+        int keep = (file < 0 || ftw_testindex_is_fresh(index, file) == 0) ? 1 : 0;
+
+        for (unsigned int t = 0; keep == 0 && file >= 0 && t < index->files[file].tests_count; t++) {
+            const ftw_indexed_file * ifile = &index->files[file];
+            const ftw_indexed_test * test  = &index->tests[ifile->first_test + t];
+            keep = ftw_run_selected(opts, test->rule_id, test->test_id, ftw_run_relative_path(opts, ifile->path), ifile->tags, ifile->tags_count);
+        }
+        if (keep == 1) {
+            tests[kept++] = tests[i];
+        }
+        else {
+            free(tests[i]);
+        }
+    }
+    *test_count = kept;
+    ftw_testindex_free(index);
+}
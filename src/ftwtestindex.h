@@ -0,0 +1,70 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwtestindex.h
+// prebuilt index of the test files for the listing and the selection
+//
+
+#ifndef _FTWTESTINDEX_H
+#define _FTWTESTINDEX_H
+
+#define FTWRUNNER_TESTINDEX ".ftwrunner.index"
+
+#define FTW_TESTINDEX_MAGIC "ftwrunner-index 2"
+
+struct ftw_run_opts_t;
+
+typedef struct ftw_indexed_test_t {
+    unsigned int    file;          // index in ftw_testindex.files
+    unsigned int    rule_id;
+    unsigned int    test_id;
+    unsigned int    stages_count;
+    int             enabled;
+    unsigned long   payload;       // bytes of the uri, the headers and the data of the stages
+    char          * skip;          // skip reason of the first skipped stage, or NULL
+} ftw_indexed_test;
+
+typedef struct ftw_indexed_file_t {
+    char          * path;
+    long long       mtime;         // in nanoseconds
+    long long       size;
+    char         ** tags;          // meta.tags
+    unsigned int    tags_count;
+    unsigned int    first_test;    // the tests of the file in ftw_testindex.tests
+    unsigned int    tests_count;
+} ftw_indexed_file;
+
+typedef struct ftw_testindex_t {
+    char             * root;
+    ftw_indexed_file * files;      // sorted by path
+    unsigned int       files_count;
+    ftw_indexed_test * tests;
+    unsigned int       tests_count;
+    unsigned int       parsed;     // number of the files parsed by the last update
+} ftw_testindex;
+
+ftw_testindex * ftw_testindex_load(const char * path, const char * root);
+ftw_testindex * ftw_testindex_update(const ftw_testindex * index, const char * root, char ** paths, unsigned int paths_count);
+void            ftw_testindex_free(ftw_testindex * index);
+int             ftw_testindex_save(const ftw_testindex * index, const char * path);
+int             ftw_testindex_find_file(const ftw_testindex * index, const char * path);
+int             ftw_testindex_is_fresh(const ftw_testindex * index, int file);
+void            ftw_testindex_list(const struct ftw_run_opts_t * opts, const ftw_testindex * index);
+void            ftw_testindex_select_files(const struct ftw_run_opts_t * opts, const char * index_path, char ** tests, unsigned * test_count);
+
+#endif
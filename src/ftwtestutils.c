@@ -27,6 +27,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <time.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "ftwtestutils.h"
 
 /*
@@ -152,6 +156,126 @@ void parse_qs(char * q, char **** parsed, int * parsed_count) {
     return;
 }
 
+// classify a log pattern
+// returns the literal form of the pattern if it does not contain any
+// regex metacharacter (an escaped metacharacter, eg. '\.', is allowed),
+// or NULL if the pattern is a real regex and PCRE2 needed to match it
+//
+// example:
+// "id \"942100\""   -> "id \"942100\""
+// "foo\.php"        -> "foo.php"
+// "id \"94210[0-9]" -> NULL
+char * literal_pattern(const char * pattern) {
+    size_t plen = strlen(pattern);
+    char * lit  = calloc(plen + 1, sizeof(char));
+    size_t j    = 0;
+
+    if (lit == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < plen; i++) {
+        char c = pattern[i];
+        if (c == '\\') {
+            // escaped non-alphanumeric characters are literals,
+            // everything else (\d, \w, \x41, ...) is a regex construct
+            if (i + 1 < plen && !isalnum((unsigned char)pattern[i+1])) {
+                lit[j++] = pattern[++i];
+                continue;
+            }
+            free(lit);
+            return NULL;
+        }
+        if (strchr("^$.|?*+()[]{}", c) != NULL) {
+            free(lit);
+            return NULL;
+        }
+        lit[j++] = c;
+    }
+    return lit;
+}
+
+// find a literal needle in a subject, eg. in a log line
+// the candidate positions are filtered by the first and the last byte
+// of the needle (32 or 16 positions per step), the rest is checked
+// with memcmp(); the tail of the line is checked with a scalar loop
+const char * find_literal(const char * subject, size_t subject_len, const char * needle, size_t needle_len) {
+    size_t i = 0;
+
+    if (needle_len == 0) {
+        return subject;
+    }
+    if (needle_len > subject_len) {
+        return NULL;
+    }
+
+#if defined(__AVX2__)
+    const __m256i first32 = _mm256_set1_epi8(needle[0]);
+    const __m256i last32  = _mm256_set1_epi8(needle[needle_len - 1]);
+    for (; i + needle_len - 1 + 32 <= subject_len; i += 32) {
+        const __m256i blk_first = _mm256_loadu_si256((const __m256i *)(subject + i));
+        const __m256i blk_last  = _mm256_loadu_si256((const __m256i *)(subject + i + needle_len - 1));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first32, blk_first), _mm256_cmpeq_epi8(last32, blk_last)));
+        while (mask != 0) {
+            unsigned int bit = __builtin_ctz(mask);
+            if (memcmp(subject + i + bit + 1, needle + 1, needle_len - 1) == 0) {
+                return subject + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i first16 = _mm_set1_epi8(needle[0]);
+    const __m128i last16  = _mm_set1_epi8(needle[needle_len - 1]);
+    for (; i + needle_len - 1 + 16 <= subject_len; i += 16) {
+        const __m128i blk_first = _mm_loadu_si128((const __m128i *)(subject + i));
+        const __m128i blk_last  = _mm_loadu_si128((const __m128i *)(subject + i + needle_len - 1));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first16, blk_first), _mm_cmpeq_epi8(last16, blk_last)));
+        while (mask != 0) {
+            unsigned int bit = __builtin_ctz(mask);
+            if (memcmp(subject + i + bit + 1, needle + 1, needle_len - 1) == 0) {
+                return subject + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // scalar fallback and tail
+    for (; i + needle_len <= subject_len; i++) {
+        const char * c = memchr(subject + i, needle[0], subject_len - needle_len + 1 - i);
+        if (c == NULL) {
+            return NULL;
+        }
+        i = c - subject;
+        if (memcmp(c + 1, needle + 1, needle_len - 1) == 0) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// current value of the monotonic clock in nanoseconds
+unsigned long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// FNV-1a hash of a buffer, continues from hash
+// the initial value is FNV1A_INIT
+unsigned long long hash_fnv1a(const void * data, size_t len, unsigned long long hash) {
+    const unsigned char * p = (const unsigned char *)data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 /*
  * Base64 encoding/decoding (RFC1341)
  * Copyright (c) 2005-2011, Jouni Malinen <j@w1.fi>
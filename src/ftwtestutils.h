@@ -26,10 +26,18 @@
 #ifndef FTWTE_UTILS_H
 #define FTWTE_UTILS_H
 
+#include <stddef.h>
+
+#define FNV1A_INIT 0xcbf29ce484222325ULL
+
 void            hexchar(unsigned char c, unsigned char *hex1, unsigned char *hex2);
 char          * urlencode(const char * s);
 char          * unquote(const char * src);
 void            parse_qs(char * q, char **** parsed, int * parsed_count);
+char          * literal_pattern(const char * pattern);
+const char    * find_literal(const char * subject, size_t subject_len, const char * needle, size_t needle_len);
+unsigned long long monotonic_ns(void);
+unsigned long long hash_fnv1a(const void * data, size_t len, unsigned long long hash);
 unsigned char * base64_decode(const unsigned char *src, size_t len, size_t *out_len);
 
 #endif
\ No newline at end of file
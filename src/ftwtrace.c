@@ -0,0 +1,112 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwtrace.c
+// timeline of the run in the trace event format of the trace viewers
+//
+// the spans are written as complete ('X') events when they end, so the
+// file grows during the run; it's valid JSON only after the close
+// every thread which writes spans gets its own track
+// the format is the Trace Event Format of Chromium, see about:tracing or
+// the Perfetto UI
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "ftwtrace.h"
+
+// the id of the track of the calling thread
+static long trace_tid(void) {
+#ifdef SYS_gettid
+    return syscall(SYS_gettid);
+#else
+    return getpid();
+#endif
+}
+
+// write a JSON string
+static void trace_string(FILE * fp, const char * s) {
+    fputc('"', fp);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(fp, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        }
+        else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+ftw_trace * ftw_trace_open(const char * path, unsigned long long start_ns) {
+    ftw_trace * trace = calloc(1, sizeof(ftw_trace));
+
+    if (trace == NULL) {
+        return NULL;
+    }
+    if ((trace->fp = fopen(path, "w")) == NULL) {
+        free(trace);
+        return NULL;
+    }
+    trace->start_ns = start_ns;
+    trace->pid      = getpid();
+    fprintf(trace->fp, "{\"traceEvents\":[\n");
+    fprintf(trace->fp, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"ftwrunner\"}}",
+        trace->pid, trace_tid());
+    fprintf(trace->fp, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"main\"}}",
+        trace->pid, trace_tid());
+    return trace;
+}
+
+// write a span of the calling thread
+// the args is the content of a JSON object, or NULL
+void ftw_trace_span(ftw_trace * trace, const char * category, const char * name, unsigned long long start_ns, unsigned long long end_ns, const char * args) {
+    fprintf(trace->fp, ",\n{\"ph\":\"X\",\"cat\":\"%s\",\"name\":", category);
+    trace_string(trace->fp, name);
+    fprintf(trace->fp, ",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f", trace->pid, trace_tid(),
+        (double)(start_ns - trace->start_ns) / 1000.0, (double)(end_ns - start_ns) / 1000.0);
+    if (args != NULL) {
+        fprintf(trace->fp, ",\"args\":{%s}", args);
+    }
+    fprintf(trace->fp, "}");
+    trace->events++;
+}
+
+// finish the file
+// returns 0 on success
+int ftw_trace_close(ftw_trace * trace) {
+    int ret;
+
+    if (trace == NULL) {
+        return 0;
+    }
+    fprintf(trace->fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    ret = (ferror(trace->fp) != 0) ? -1 : 0;
+    if (fclose(trace->fp) != 0) {
+        ret = -1;
+    }
+    free(trace);
+    return ret;
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwtrace.h
+// timeline of the run in the trace event format of the trace viewers
+//
+
+#ifndef _FTWTRACE_H
+#define _FTWTRACE_H
+
+#include <stdio.h>
+
+typedef struct ftw_trace_t {
+    FILE               * fp;
+    unsigned long long   start_ns;     // the time 0 of the timeline
+    int                  pid;
+    unsigned long long   events;
+} ftw_trace;
+
+ftw_trace * ftw_trace_open(const char * path, unsigned long long start_ns);
+void        ftw_trace_span(ftw_trace * trace, const char * category, const char * name, unsigned long long start_ns, unsigned long long end_ns, const char * args);
+int         ftw_trace_close(ftw_trace * trace);
+
+#endif
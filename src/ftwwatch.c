@@ -0,0 +1,432 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwwatch.c
+// watching directories for changed files (inotify)
+//
+// the directories are watched instead of the files, because editors
+// often replace the file instead of writing it
+// the watch mode runs the changed tests and the tests of the changed
+// rules again
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <libgen.h>
+
+#include "ftwwatch.h"
+#include "ftwrun.h"
+#include "ftwrunner.h"
+#include "ftwtestutils.h"
+#include "walkdir.h"
+#include "config.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#include <poll.h>
+#include <sys/inotify.h>
+
+#define FTW_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+ftw_watch * ftw_watch_new(void) {
+    ftw_watch * watch = calloc(1, sizeof(ftw_watch));
+
+    if (watch == NULL) {
+        return NULL;
+    }
+    if ((watch->fd = inotify_init1(IN_CLOEXEC)) < 0) {
+        perror("inotify_init1");
+        free(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+void ftw_watch_free(ftw_watch * watch) {
+    if (watch == NULL) {
+        return;
+    }
+    for (int i = 0; i < watch->count; i++) {
+        free(watch->dirs[i]);
+    }
+    free(watch->wds);
+    free(watch->dirs);
+    free(watch->recursive);
+    close(watch->fd);
+    free(watch);
+}
+
+// find the directory of a watch descriptor
+static int watch_find(const ftw_watch * watch, int wd) {
+    for (int i = 0; i < watch->count; i++) {
+        if (watch->wds[i] == wd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// watch a directory, and its subdirectories if recursive is 1
+// returns 0, or -1 on error
+int ftw_watch_add_dir(ftw_watch * watch, const char * dir, int recursive) {
+    char            resolved[PATH_MAX];
+    int             wd;
+    DIR           * dp;
+    struct dirent * entry;
+
+    if (realpath(dir, resolved) == NULL) {
+        return -1;
+    }
+    if ((wd = inotify_add_watch(watch->fd, resolved, FTW_WATCH_MASK)) < 0) {
+        fprintf(stderr, "Warning: can't watch %s\n", resolved);
+        return -1;
+    }
+    // the same inode gives the same descriptor
+    int i = watch_find(watch, wd);
+    if (i < 0) {
+        watch->wds       = realloc(watch->wds, sizeof(int) * (watch->count + 1));
+        watch->dirs      = realloc(watch->dirs, sizeof(char *) * (watch->count + 1));
+        watch->recursive = realloc(watch->recursive, sizeof(int) * (watch->count + 1));
+        if (watch->wds == NULL || watch->dirs == NULL || watch->recursive == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        i = watch->count++;
+        watch->wds[i]       = wd;
+        watch->dirs[i]      = strdup(resolved);
+        watch->recursive[i] = 0;
+    }
+    if (recursive == 0 || watch->recursive[i] == 1) {
+        return 0;
+    }
+    watch->recursive[i] = 1;
+
+    if ((dp = opendir(resolved)) == NULL) {
+        return 0;
+    }
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_type == DT_DIR && strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            char sub[PATH_MAX];
+            if (snprintf(sub, sizeof(sub), "%s/%s", resolved, entry->d_name) < (int)sizeof(sub)) {
+                ftw_watch_add_dir(watch, sub, 1);
+            }
+        }
+    }
+    closedir(dp);
+    return 0;
+}
+
+// add a path to the list of the changed files if it's not there
+static void watch_add_changed(char *** changed, int * changed_count, const char * path) {
+    for (int i = 0; i < *changed_count; i++) {
+        if (strcmp((*changed)[i], path) == 0) {
+            return;
+        }
+    }
+    *changed = realloc(*changed, sizeof(char *) * (*changed_count + 2));
+    if (*changed == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    (*changed)[(*changed_count)++] = strdup(path);
+    (*changed)[*changed_count]     = NULL;
+}
+
+// wait for changes, and collect the changed files until debounce_ms
+// passes without a new event
+// the list of the paths is NULL terminated
+// returns the number of the changed files, or -1 on error
+int ftw_watch_wait(ftw_watch * watch, int debounce_ms, char *** changed, int * changed_count) {
+    char          buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd;
+    int           timeout = -1;
+
+    *changed       = NULL;
+    *changed_count = 0;
+    pfd.fd         = watch->fd;
+    pfd.events     = POLLIN;
+
+    while (1) {
+        int rc = poll(&pfd, 1, timeout);
+        if (rc < 0) {
+            perror("poll");
+            return -1;
+        }
+        if (rc == 0) {
+            if (*changed_count > 0) {
+                break;
+            }
+            continue;
+        }
+        ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            perror("read");
+            return -1;
+        }
+        for (char * p = buffer; p < buffer + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+            const struct inotify_event * event = (const struct inotify_event *)p;
+            int                          i     = watch_find(watch, event->wd);
+            char                         path[PATH_MAX];
+
+            if (i < 0 || event->len == 0) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%s", watch->dirs[i], event->name);
+            if (event->mask & IN_ISDIR) {
+                if (watch->recursive[i] == 1 && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    ftw_watch_add_dir(watch, path, 1);
+                }
+                continue;
+            }
+            watch_add_changed(changed, changed_count, path);
+        }
+        timeout = debounce_ms;
+    }
+    return *changed_count;
+}
+
+#else
+
+ftw_watch * ftw_watch_new(void) {
+    fprintf(stderr, "Error: watch mode needs inotify, which is not available on this system\n");
+    return NULL;
+}
+
+void ftw_watch_free(ftw_watch * watch) {
+    free(watch);
+}
+
+int ftw_watch_add_dir(ftw_watch * watch, const char * dir, int recursive) {
+    return -1;
+}
+
+int ftw_watch_wait(ftw_watch * watch, int debounce_ms, char *** changed, int * changed_count) {
+    return -1;
+}
+
+#endif
+
+// (re)load a test file of the watch mode
+// the collection is NULL if the file can't be parsed or it was removed
+static void watched_file_load(ftw_parsed_file * file, const ftw_run_opts * opts) {
+    if (file->collection != NULL) {
+        ftwtestcollection_free(file->collection);
+        file->collection = NULL;
+    }
+    if (file->yroot != NULL) {
+        yaml_item_free(file->yroot);
+        file->yroot = NULL;
+    }
+    if (access(file->path, F_OK) != 0) {
+        return;
+    }
+    if ((file->yroot = parse_yaml(file->path)) == NULL) {
+        fprintf(stderr, "Error: failed to parse YAML file: %s\n", file->path);
+        return;
+    }
+    if ((file->collection = ftwtestcollection_new(file->yroot, opts->rule_test, opts->rule_test_id)) == NULL) {
+        fprintf(stderr, "Error parsing file %s! (Memory allocation error)\n", file->path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// add the ids of the rules declared in a config file to the list
+static void file_rule_ids(const ftw_ruleindex * ruleindex, const char * path, unsigned int ** ids, unsigned int * ids_count) {
+    int data_file = (ruleindex != NULL) ? ftw_ruleindex_is_data_file(ruleindex, path) : 0;
+
+    for (unsigned int f = 0; ruleindex != NULL && f < ruleindex->files_count; f++) {
+        // a data file belongs to the config files which use it
+        if (strcmp(ruleindex->files[f].path, path) != 0 && (data_file == 0 || ftw_ruleindex_file_uses(ruleindex, f, path) == 0)) {
+            continue;
+        }
+        for (unsigned int r = 0; r < ruleindex->rules_count; r++) {
+            if (ruleindex->rules[r].file == f) {
+                *ids = realloc(*ids, sizeof(unsigned int) * (*ids_count + 1));
+                (*ids)[(*ids_count)++] = ruleindex->rules[r].id;
+            }
+        }
+    }
+}
+
+// watch the directories of the config files and their data files
+static void watch_rule_dirs(ftw_watch * watch, const ftw_ruleindex * ruleindex) {
+    unsigned int count = ruleindex->files_count + ruleindex->data_files_count;
+
+    for (unsigned int i = 0; i < count; i++) {
+        char * dircopy = strdup((i < ruleindex->files_count) ? ruleindex->files[i].path : ruleindex->data_files[i - ruleindex->files_count]);
+        ftw_watch_add_dir(watch, dirname(dircopy), 0);
+        free(dircopy);
+    }
+}
+
+// watch the tests and the rules, and run the tests again if the files
+// change:
+// - a changed test file is parsed and run again
+// - if a rule file changes, the rules are loaded again, and the tests of
+//   the rules of that file are run again
+// - if a data file of the operators changes, the rules are loaded again,
+//   and the tests of the rules of the files which use it are run again
+// - if a file with 'Include' directives changes, every test runs again
+int ftw_watch_run(const ftw_run_opts * opts, ftw_engine ** engine, char ** tests, unsigned test_count) {
+    ftw_watch        * watch       = ftw_watch_new();
+    ftw_ruleindex    * ruleindex   = NULL;
+    ftw_parsed_file * files       = NULL;
+    unsigned           files_count = 0;
+    int              * selected    = NULL;
+    char               rootdir[PATH_MAX];
+    char             * dircopy;
+
+    if (watch == NULL || realpath(opts->ftwtest_root, rootdir) == NULL) {
+        ftw_watch_free(watch);
+        return -1;
+    }
+    ftw_watch_add_dir(watch, rootdir, 1);
+    dircopy = strdup(opts->modsecurity_config);
+    ftw_watch_add_dir(watch, dirname(dircopy), 0);
+    free(dircopy);
+    if ((ruleindex = ftw_ruleindex_new(opts->modsecurity_config)) != NULL) {
+        watch_rule_dirs(watch, ruleindex);
+    }
+
+    qsort(tests, test_count, sizeof(char *), walkcmp);
+    files    = calloc(test_count, sizeof(ftw_parsed_file));
+    selected = calloc(test_count, sizeof(int));
+    for (unsigned i = 0; i < test_count; i++) {
+        char resolved[PATH_MAX];
+        files[files_count].path = strdup((realpath(tests[i], resolved) != NULL) ? resolved : tests[i]);
+        watched_file_load(&files[files_count], opts);
+        selected[files_count++] = 1;
+        free(tests[i]);
+    }
+    free(tests);
+
+    while (1) {
+        char             ** changed       = NULL;
+        int                 changed_count = 0;
+        unsigned int      * ids           = NULL;
+        unsigned int        ids_count     = 0;
+        int                 rerun_all     = 0;
+        int                 rules_changed = 0;
+        unsigned long long  start         = monotonic_ns();
+        int                 run_count     = 0;
+
+        ftw_engine_reset(*engine);
+        for (unsigned i = 0; i < files_count; i++) {
+            if (selected[i] == 1 && files[i].collection != NULL) {
+                ftw_run_collection(*engine, NULL, opts, files[i].path, files[i].collection, NULL, NULL);
+                run_count++;
+            }
+            selected[i] = 0;
+        }
+        if (run_count > 0) {
+            ftw_engine_show_result(*engine);
+            logCbClearLog();
+            printf("%d test files run in %.2f ms\n", run_count, (double)(monotonic_ns() - start) / 1000000.0);
+        }
+        printf("Watching %s and the rule files for changes, press Ctrl-C to stop\n", rootdir);
+        fflush(stdout);
+
+        if (ftw_watch_wait(watch, FTW_WATCH_DEBOUNCE_MS, &changed, &changed_count) < 0) {
+            break;
+        }
+        for (int c = 0; c < changed_count; c++) {
+            size_t len = strlen(changed[c]);
+            if (len > 5 && strcmp(changed[c] + len - 5, ".yaml") == 0 && strncmp(changed[c], rootdir, strlen(rootdir)) == 0) {
+                unsigned i;
+                for (i = 0; i < files_count && strcmp(files[i].path, changed[c]) != 0; i++);
+                if (i == files_count) {
+                    files    = realloc(files, sizeof(ftw_parsed_file) * (files_count + 1));
+                    selected = realloc(selected, sizeof(int) * (files_count + 1));
+                    memset(&files[i], 0, sizeof(ftw_parsed_file));
+                    files[i].path = strdup(changed[c]);
+                    files_count++;
+                }
+                printf("Changed: %s\n", changed[c]);
+                watched_file_load(&files[i], opts);
+                selected[i] = 1;
+            }
+            else if (ruleindex == NULL || ftw_ruleindex_find_file(ruleindex, changed[c]) >= 0 || ftw_ruleindex_is_data_file(ruleindex, changed[c]) == 1
+                     || (len > 5 && strcmp(changed[c] + len - 5, ".conf") == 0)) {
+                int fi   = (ruleindex != NULL) ? ftw_ruleindex_find_file(ruleindex, changed[c]) : -1;
+                int data = (ruleindex != NULL) ? ftw_ruleindex_is_data_file(ruleindex, changed[c]) : 0;
+                printf("Changed: %s\n", changed[c]);
+                rules_changed = 1;
+                // a new file, or a file with includes: the whole config can be affected
+                if ((fi < 0 && data == 0) || (fi >= 0 && ruleindex->files[fi].includes > 0)) {
+                    rerun_all = 1;
+                }
+                file_rule_ids(ruleindex, changed[c], &ids, &ids_count);
+            }
+        }
+
+        if (rules_changed == 1) {
+            const char * errormsg = NULL;
+            ftw_engine * new_engine;
+
+            start      = monotonic_ns();
+            new_engine = ftw_run_load_engine(opts, ftw_run_index_rules(opts, 0), &errormsg);
+            if (new_engine == NULL) {
+                fprintf(stderr, "ftwrunner init error: %s\n", errormsg);
+                fprintf(stderr, "The previous rules are kept\n");
+            }
+            else {
+                ftw_engine_free(*engine);
+                *engine = new_engine;
+                printf("Rules reloaded in %.2f ms\n", (double)(monotonic_ns() - start) / 1000000.0);
+            }
+            ftw_ruleindex_free(ruleindex);
+            if ((ruleindex = ftw_ruleindex_new(opts->modsecurity_config)) != NULL) {
+                watch_rule_dirs(watch, ruleindex);
+            }
+            // the rules declared by the changed files after the change
+            for (int c = 0; c < changed_count; c++) {
+                file_rule_ids(ruleindex, changed[c], &ids, &ids_count);
+            }
+            for (unsigned i = 0; i < files_count; i++) {
+                if (files[i].collection == NULL) {
+                    continue;
+                }
+                for (unsigned int r = 0; r < ids_count && selected[i] == 0; r++) {
+                    selected[i] = (ids[r] == files[i].collection->rule_id) ? 1 : 0;
+                }
+                selected[i] = (rerun_all == 1) ? 1 : selected[i];
+            }
+        }
+        free(ids);
+        FTW_FREE_STRINGLIST(changed);
+    }
+
+    for (unsigned i = 0; i < files_count; i++) {
+        if (files[i].collection != NULL) {
+            ftwtestcollection_free(files[i].collection);
+        }
+        if (files[i].yroot != NULL) {
+            yaml_item_free(files[i].yroot);
+        }
+        free(files[i].path);
+    }
+    free(files);
+    free(selected);
+    ftw_ruleindex_free(ruleindex);
+    ftw_watch_free(watch);
+    return -1;
+}
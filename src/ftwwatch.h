@@ -0,0 +1,48 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ftwwatch.h
+// watching directories for changed files (inotify)
+//
+
+#ifndef _FTWWATCH_H
+#define _FTWWATCH_H
+
+#include "engines/engines.h"
+
+struct ftw_run_opts_t;
+
+// wait this long for more events after the first one, editors write
+// a file in more steps
+#define FTW_WATCH_DEBOUNCE_MS 100
+
+typedef struct ftw_watch_t {
+    int            fd;
+    int          * wds;        // watch descriptors
+    char        ** dirs;       // the watched directory of the descriptors
+    int          * recursive;  // watch the new subdirectories too
+    int            count;
+} ftw_watch;
+
+ftw_watch * ftw_watch_new(void);
+void        ftw_watch_free(ftw_watch * watch);
+int         ftw_watch_add_dir(ftw_watch * watch, const char * dir, int recursive);
+int         ftw_watch_wait(ftw_watch * watch, int debounce_ms, char *** changed, int * changed_count);
+int         ftw_watch_run(const struct ftw_run_opts_t * opts, ftw_engine ** engine, char ** tests, unsigned test_count);
+
+#endif
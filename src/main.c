@@ -21,23 +21,42 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
 
 #include "ftwrunner.h"
 #include "yamlapi.h"
 #include "walkdir.h"
+#include "ruleindex.h"
+#include "ftwrun.h"
+#include "ftwdaemon.h"
+#include "ftwwatch.h"
+#include "ftwcache.h"
+#include "ftwimpact.h"
+#include "ftwtestindex.h"
+#include "ftwsample.h"
+#include "ftwjournal.h"
+#include "ftwselect.h"
+#include "ftwminimize.h"
+#include "ftwprofile.h"
+#include "ftwlatency.h"
+#include "ftwalloc.h"
+#include "ftwsoak.h"
+#include "ftwperf.h"
+#include "ftwtrace.h"
 #include "ftwtest.h"
+#include "ftwtestutils.h"
 #include "engines/engines.h"
 #include "config.h"
 
-
 static char available_engines[3][20] = {"dummy", "", ""};
 static int engine_count = 1;
 
 void showhelp(void) {
-    printf("Use: %s [OPTIONS]\n\n", PRGNAME);
+    printf("Use: %s [OPTIONS] [COMMAND]\n\n", PRGNAME);
     printf("OPTIONS:\n");
     printf("\t-h\tThis help\n");
     printf("\t-c\tUse alternative config instead of ftwrunner.yaml in same directory\n");
@@ -45,32 +64,275 @@ void showhelp(void) {
     printf("\t-m\tUse alternative ModSecurity config instead of in default config\n");
     printf("\t-r\tUse only this rule test, eg. '-r 911100'\n");
     printf("\t-t\tUse only this test of all, eg. '-t 1'\n");
+    printf("\t-s\tUse only the tests selected by an expression, eg. '-s 941*,942100..942190,!942130..942137', or '@file'\n");
     printf("\t-o\tUse overrides from file\n");
     printf("\t-e\tUse WAF engine\n");
     printf("\t  \tavailable engines:\n");
     for(int i = 0; i < engine_count; i++) {
         printf("\t  \t- %s\n", available_engines[i]);
     }
+    printf("\t-b\tStop processing at the first disruptive intervention, like a real server\n");
+    printf("\t-a\tProcess all phases, even if no assertion depends on the response phases\n");
+    printf("\t-M\tLoad only the rule files needed for the rule given by '-r'\n");
+    printf("\t-V\tCompare the results with a serially loaded full config ('-M' if no '-M' or '-P')\n");
+    printf("\t-P\tWith '-V', check that the rule files loaded in N groups and merged work as the full config (modsecurity)\n");
     printf("\t-d  \tShow detailed information.\n");
     printf("\t-v  \tVerbose output.\n");
+    printf("\t--daemon\tLoad the rules once, and run the requests of the clients\n");
+    printf("\t--client\tRun the tests selected by '-f', '-r' and '-t' on the daemon\n");
+    printf("\t--reload\tLoad the rules of the daemon again if the config files changed\n");
+    printf("\t--stop  \tStop the daemon\n");
+    printf("\t--socket\tUse this unix socket instead of %s\n", FTWRUNNER_SOCKET);
+    printf("\t--watch \tRun the tests again if the test or the rule files change\n");
+    printf("\t--cached\tReuse the results of the unchanged tests from %s\n", FTWRUNNER_CACHE);
+    printf("\t--cache-file\tUse this result cache file, implies '--cached'\n");
+    printf("\t--reverify\tRun every test, and refresh the result cache\n");
+    printf("\t--dedup \tSend the identical requests once, and check every stage on the same log\n");
+    printf("\t--list  \tList the tests selected by '-r' and '-t' from the test index\n");
+    printf("\t--index-file\tUse this test index instead of %s\n", FTWRUNNER_TESTINDEX);
+    printf("\t--resume\tContinue the interrupted run from the journal\n");
+    printf("\t--rerun-failed\tRun only the failed tests of the last run, '=all' with the whitelisted ones\n");
+    printf("\t--journal\tUse this journal instead of %s\n", FTWRUNNER_JOURNAL);
+    printf("\t--sample\tRun a sample of P%% or N tests, stratified by the category directories and the rules, rotated by the seed\n");
+    printf("\t--seed  \tChoose the sample by this seed instead of the number of the day\n");
+    printf("\t--slowest\tShow the N slowest tests, and the N slowest rules by total and p99 transaction time\n");
+    printf("\t--alloc-stats\tCount the allocations of the transactions, and show the N most allocating tests and rules\n");
+    printf("\t--perf-counters\tCount the instructions, cycles, cache and branch misses of the transactions, and show the N costliest tests and rules\n");
+    printf("\t--soak  \tRun the tests N times, and show the tests whose memory grows with the iterations\n");
+    printf("\t--soak-threshold\tReport the tests growing at least this many bytes per iteration, default %d\n", FTW_SOAK_THRESHOLD);
+    printf("\t--trace \tWrite the timeline of the tests, stages and engine phases to a trace event file\n");
+    printf("\t--profile\tWrite the wall and CPU time of the tests to a file, and show the time of the parts of the run\n");
+    printf("\t--phase-times\tShow the histograms of the durations of the transaction phases\n");
+    printf("\t--timeout\tStop the transaction of a stage after this time, eg. '5s', and show it as TIMEOUT\n");
+    printf("\t--time-budget\tRun the most important tests first, and stop after this time, eg. '90s'\n");
+    printf("\t--minimal-file\tWrite the tests of 'minimize' to this file instead of %s\n", FTWRUNNER_MINIMAL);
+    printf("\t--affected-by\tRun only the tests affected by a changed config file, a diff, or 'git[:REV]'\n");
+    printf("\t--fired-db\tRecord the fired rules of the tests in this file instead of %s\n", FTWRUNNER_FIRED);
+    printf("\n");
+    printf("COMMANDS:\n");
+    printf("\tindex\tCreate the test index for '--list' and the selection\n");
+    printf("\tminimize\tRun the tests, and write the smallest subset with the same fired rules\n");
     printf("\n");
 }
 
+// hash of the environment of the cached results: the content of the config
+// files and their data files, the engine, and the options which can change the results
+// the version of the engine is added after the engine is created
+static unsigned long long cache_env_hash(const ftw_run_opts * opts, const ftw_ruleindex * ruleindex) {
+    unsigned long long hash  = FNV1A_INIT;
+    unsigned int       count = (ruleindex != NULL) ? ruleindex->files_count + ruleindex->data_files_count : 1;
+    int                options[] = {opts->stop_on_disruptive, opts->all_phases, opts->minimal_config,
+                                    (opts->minimal_config == 1) ? (int)opts->rule_test : 0, opts->rule_groups};
+
+    // the config files, then the data files of the operators
+    for (unsigned int i = 0; i < count; i++) {
+        const char * path = (ruleindex == NULL) ? opts->modsecurity_config :
+                            (i < ruleindex->files_count) ? ruleindex->files[i].path : ruleindex->data_files[i - ruleindex->files_count];
+        FILE       * fp   = fopen(path, "r");
+        char         buffer[8192];
+        size_t       n;
+
+        hash = hash_fnv1a(path, strlen(path) + 1, hash);
+        if (fp == NULL) {
+            continue;
+        }
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            hash = hash_fnv1a(buffer, n, hash);
+        }
+        fclose(fp);
+    }
+    hash = hash_fnv1a(opts->ftwengine, strlen(opts->ftwengine) + 1, hash);
+    hash = hash_fnv1a(VERSION, strlen(VERSION) + 1, hash);
+    return hash_fnv1a(options, sizeof(options), hash);
+}
+
+// hash of a run for the journal: the paths of the config and the tests,
+// the engine, the selection and the options
+// the content of the files is left out, the failed tests are fixed there
+static unsigned long long journal_run_hash(const ftw_run_opts * opts) {
+    unsigned long long hash      = FNV1A_INIT;
+    unsigned int       options[] = {opts->rule_test, opts->rule_test_id, (unsigned int)opts->stop_on_disruptive,
+                                    (unsigned int)opts->all_phases, (unsigned int)opts->minimal_config};
+
+    hash = hash_fnv1a(opts->modsecurity_config, strlen(opts->modsecurity_config) + 1, hash);
+    hash = hash_fnv1a(opts->ftwtest_root, strlen(opts->ftwtest_root) + 1, hash);
+    hash = hash_fnv1a(opts->ftwengine, strlen(opts->ftwengine) + 1, hash);
+    if (opts->select_expr != NULL) {
+        hash = hash_fnv1a(opts->select_expr, strlen(opts->select_expr) + 1, hash);
+    }
+    if (opts->sample != NULL) {
+        hash = hash_fnv1a(opts->sample_arg, strlen(opts->sample_arg) + 1, hash);
+        hash = hash_fnv1a(&opts->sample->seed, sizeof(opts->sample->seed), hash);
+    }
+    return hash_fnv1a(options, sizeof(options), hash);
+}
+
+// parse a duration, eg. '90s', '1500ms', '5m'; the default unit is second
+// returns 0 on error
+static unsigned long long parse_duration(const char * arg) {
+    char   * end;
+    double   value = strtod(arg, &end);
+
+    if (end == arg || value <= 0) {
+        return 0;
+    }
+    if (*end == '\0' || strcmp(end, "s") == 0) {
+        return (unsigned long long)(value * 1000000000.0);
+    }
+    if (strcmp(end, "ms") == 0) {
+        return (unsigned long long)(value * 1000000.0);
+    }
+    if (strcmp(end, "m") == 0) {
+        return (unsigned long long)(value * 60000000000.0);
+    }
+    if (strcmp(end, "h") == 0) {
+        return (unsigned long long)(value * 3600000000000.0);
+    }
+    return 0;
+}
+
+// the modes of ftwrunner, some options can't be used in some of them
+enum {
+    FTW_MODE_DAEMON   = 1 << 0,
+    FTW_MODE_WATCH    = 1 << 1,
+    FTW_MODE_CLIENT   = 1 << 2,
+    FTW_MODE_INDEX    = 1 << 3,
+    FTW_MODE_LIST     = 1 << 4,
+    FTW_MODE_MINIMIZE = 1 << 5,
+    FTW_MODE_SOAK     = 1 << 6
+};
+
+static const char * mode_names[] = {
+    "in daemon mode", "in watch mode", "in client mode", "with 'index'", "with '--list'", "with 'minimize'", "with '--soak'"
+};
+
+// an option of the command line, and the modes where it can't be used
+typedef struct ftw_mode_conflict_t {
+    const char * option;
+    int          given;
+    int          modes;
+} ftw_mode_conflict;
+
+// check the given options against the modes of the run
+// returns 0, or -1 if an option can't be used in a mode
+static int check_mode_conflicts(const ftw_mode_conflict * conflicts, unsigned int count, int modes) {
+    for (unsigned int i = 0; i < count; i++) {
+        int clash = (conflicts[i].given != 0) ? (conflicts[i].modes & modes) : 0;
+        int m     = 0;
+
+        if (clash == 0) {
+            continue;
+        }
+        while ((clash & (1 << m)) == 0) {
+            m++;
+        }
+        fprintf(stderr, "Error: %s can't be used %s!\n", conflicts[i].option, mode_names[m]);
+        return -1;
+    }
+    return 0;
+}
+
+enum {
+    OPT_DAEMON = 256,
+    OPT_SOCKET,
+    OPT_CLIENT,
+    OPT_RELOAD,
+    OPT_STOP,
+    OPT_WATCH,
+    OPT_CACHED,
+    OPT_CACHE_FILE,
+    OPT_REVERIFY,
+    OPT_AFFECTED_BY,
+    OPT_FIRED_DB,
+    OPT_DEDUP,
+    OPT_LIST,
+    OPT_INDEX_FILE,
+    OPT_RESUME,
+    OPT_RERUN_FAILED,
+    OPT_JOURNAL,
+    OPT_SAMPLE,
+    OPT_SEED,
+    OPT_MINIMAL_FILE,
+    OPT_TIME_BUDGET,
+    OPT_PHASE_TIMES,
+    OPT_PROFILE,
+    OPT_SLOWEST,
+    OPT_ALLOC_STATS,
+    OPT_SOAK,
+    OPT_SOAK_THRESHOLD,
+    OPT_PERF_COUNTERS,
+    OPT_TRACE,
+    OPT_TIMEOUT
+};
+
+static const struct option long_options[] = {
+    {"help",   no_argument,       NULL, 'h'},
+    {"daemon", no_argument,       NULL, OPT_DAEMON},
+    {"socket", required_argument, NULL, OPT_SOCKET},
+    {"client", no_argument,       NULL, OPT_CLIENT},
+    {"reload", no_argument,       NULL, OPT_RELOAD},
+    {"stop",   no_argument,       NULL, OPT_STOP},
+    {"watch",  no_argument,       NULL, OPT_WATCH},
+    {"cached", no_argument,       NULL, OPT_CACHED},
+    {"cache-file", required_argument, NULL, OPT_CACHE_FILE},
+    {"reverify", no_argument,     NULL, OPT_REVERIFY},
+    {"affected-by", required_argument, NULL, OPT_AFFECTED_BY},
+    {"fired-db", required_argument, NULL, OPT_FIRED_DB},
+    {"dedup",  no_argument,       NULL, OPT_DEDUP},
+    {"list",   no_argument,       NULL, OPT_LIST},
+    {"index-file", required_argument, NULL, OPT_INDEX_FILE},
+    {"resume", no_argument,       NULL, OPT_RESUME},
+    {"rerun-failed", optional_argument, NULL, OPT_RERUN_FAILED},
+    {"journal", required_argument, NULL, OPT_JOURNAL},
+    {"sample", required_argument, NULL, OPT_SAMPLE},
+    {"seed",   required_argument, NULL, OPT_SEED},
+    {"minimal-file", required_argument, NULL, OPT_MINIMAL_FILE},
+    {"time-budget", required_argument, NULL, OPT_TIME_BUDGET},
+    {"phase-times", no_argument,  NULL, OPT_PHASE_TIMES},
+    {"profile", required_argument, NULL, OPT_PROFILE},
+    {"slowest", required_argument, NULL, OPT_SLOWEST},
+    {"alloc-stats", required_argument, NULL, OPT_ALLOC_STATS},
+    {"soak",   required_argument, NULL, OPT_SOAK},
+    {"soak-threshold", required_argument, NULL, OPT_SOAK_THRESHOLD},
+    {"perf-counters", required_argument, NULL, OPT_PERF_COUNTERS},
+    {"trace",  required_argument, NULL, OPT_TRACE},
+    {"timeout", required_argument, NULL, OPT_TIMEOUT},
+    {NULL,     0,                 NULL, 0}
+};
 
 int main(int argc, char **argv) {
 
-    int  debug                = 0;
-    int  verbose              = 0;
-    char c;
+    ftw_run_opts opts         = {0};
+    int  verify_full          = 0;
+    int  daemon_mode          = 0;
+    int  watch_mode           = 0;
+    int  use_cache            = 0;
+    int  reverify             = 0;
+    int  dedup                = 0;
+    int  list_mode            = 0;
+    int  index_command        = 0;
+    int  minimize_command     = 0;
+    int  phase_times          = 0;
+    const char * client_req   = NULL;
+    int  c;
     char *ftwconfig           = NULL;
-    char *modsecurity_config  = NULL;
-    char *ftwtest_root        = NULL;
-    unsigned int rule_test    = 0;
-    unsigned int rule_test_id = 0;
-    char **test_whitelist     = NULL;
-    int test_whitelist_count  = 0;
-    char *ftwengine           = NULL;
     char *overrides           = NULL;
+    char *socket_path         = NULL;
+    char *cache_path          = NULL;
+    char *fired_path          = NULL;
+    char *index_path          = NULL;
+    char *journal_path        = NULL;
+    char *minimal_path        = NULL;
+    char *select_file         = NULL;
+    char *profile_path        = NULL;
+    char *trace_path          = NULL;
+    unsigned long long main_start = monotonic_ns();
+    unsigned long long part_start;
+    // the default seed changes daily, so the sample rotates
+    unsigned long long seed   = (unsigned long long)time(NULL) / 86400;
+    unsigned long long budget_ns = 0;
+    unsigned long long timeout_ns = 0;
+    unsigned int soak_iterations = 0;
 
     char     **tests          = NULL;
     unsigned   test_count     = 0;
@@ -87,7 +349,7 @@ strcpy(available_engines[engine_count++], "coraza");
 #endif
 
     // parse arguments
-    while ((c = getopt (argc, argv, "hdvc:m:r:t:f:e:o:")) != -1) {
+    while ((c = getopt_long(argc, argv, "hdvbaMVc:m:r:t:s:f:e:o:P:", long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
                 showhelp();
@@ -96,36 +358,180 @@ strcpy(available_engines[engine_count++], "coraza");
                 ftwconfig    = strdup(optarg);
                 break;
             case 'm':
-                modsecurity_config = strdup(optarg);
+                opts.modsecurity_config = strdup(optarg);
                 break;
             case 'r':
-                rule_test    = atoi(optarg);
+                opts.rule_test    = atoi(optarg);
                 break;
             case 't':
-                rule_test_id = atoi(optarg);
+                opts.rule_test_id = atoi(optarg);
+                break;
+            case 's':
+                opts.select_expr = optarg;
                 break;
             case 'f':
-                ftwtest_root = strdup(optarg);
+                opts.ftwtest_root = strdup(optarg);
                 break;
             case 'e':
-                ftwengine    = strdup(optarg);
+                opts.ftwengine    = strdup(optarg);
                 break;
             case 'd':
-                debug = 1;
+                opts.debug = 1;
                 break;
             case 'v':
-                verbose = 1;
+                opts.verbose = 1;
+                break;
+            case 'b':
+                opts.stop_on_disruptive = 1;
+                break;
+            case 'a':
+                opts.all_phases = 1;
+                break;
+            case 'V':
+                verify_full = 1;
+                break;
+            case 'M':
+                opts.minimal_config = 1;
+                break;
+            case 'P':
+                opts.rule_groups  = atoi(optarg);
                 break;
             case 'o':
-                overrides    = strdup(optarg); // cppcheck-suppress unreadVariable
+                overrides    = strdup(optarg);
+                break;
+            case OPT_DAEMON:
+                daemon_mode  = 1;
+                break;
+            case OPT_SOCKET:
+                socket_path  = strdup(optarg);
+                break;
+            case OPT_CLIENT:
+                client_req   = FTW_DAEMON_REQ_RUN;
+                break;
+            case OPT_RELOAD:
+                client_req   = FTW_DAEMON_REQ_RELOAD;
+                break;
+            case OPT_STOP:
+                client_req   = FTW_DAEMON_REQ_STOP;
+                break;
+            case OPT_WATCH:
+                watch_mode   = 1;
+                break;
+            case OPT_CACHED:
+                use_cache    = 1;
+                break;
+            case OPT_CACHE_FILE:
+                use_cache    = 1;
+                cache_path   = strdup(optarg);
+                break;
+            case OPT_REVERIFY:
+                use_cache    = 1;
+                reverify     = 1;
+                break;
+            case OPT_AFFECTED_BY:
+                opts.affected_by = optarg;
+                break;
+            case OPT_FIRED_DB:
+                fired_path   = strdup(optarg);
+                break;
+            case OPT_DEDUP:
+                dedup        = 1;
+                break;
+            case OPT_LIST:
+                list_mode    = 1;
+                break;
+            case OPT_INDEX_FILE:
+                index_path   = strdup(optarg);
+                break;
+            case OPT_RESUME:
+                opts.journal_mode = FTW_JOURNAL_RESUME;
+                break;
+            case OPT_RERUN_FAILED:
+                if (optarg != NULL && strcmp(optarg, "all") != 0) {
+                    fprintf(stderr, "Unknown argument of '--rerun-failed': %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.journal_mode = (optarg != NULL) ? FTW_JOURNAL_RERUN_FAILED_ALL : FTW_JOURNAL_RERUN_FAILED;
+                break;
+            case OPT_JOURNAL:
+                journal_path = strdup(optarg);
+                break;
+            case OPT_SAMPLE:
+                opts.sample_arg = optarg;
+                break;
+            case OPT_SEED:
+                seed         = strtoull(optarg, NULL, 10);
+                break;
+            case OPT_MINIMAL_FILE:
+                minimal_path = strdup(optarg);
+                break;
+            case OPT_SLOWEST:
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Error: invalid number of the slowest tests '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.slowest = atoi(optarg);
+                break;
+            case OPT_ALLOC_STATS:
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Error: invalid number of the allocating tests '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.alloc_top = atoi(optarg);
+                break;
+            case OPT_PERF_COUNTERS:
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Error: invalid number of the costliest tests '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.perf_top = atoi(optarg);
+                break;
+            case OPT_SOAK:
+                // the slope needs two iterations after the warm up
+                if (atoi(optarg) < 3) {
+                    fprintf(stderr, "Error: invalid number of the soak iterations '%s', at least 3 is needed\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                soak_iterations = atoi(optarg);
+                break;
+            case OPT_SOAK_THRESHOLD:
+                if (atoll(optarg) <= 0) {
+                    fprintf(stderr, "Error: invalid soak threshold '%s'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.soak_threshold = atoll(optarg);
+                break;
+            case OPT_TIMEOUT:
+                if ((timeout_ns = parse_duration(optarg)) == 0) {
+                    fprintf(stderr, "Error: invalid timeout '%s', use eg. '5s' or '500ms'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case OPT_TRACE:
+                trace_path   = strdup(optarg);
+                break;
+            case OPT_PROFILE:
+                profile_path = strdup(optarg);
+                break;
+            case OPT_PHASE_TIMES:
+                phase_times  = 1;
+                break;
+            case OPT_TIME_BUDGET:
+                if ((budget_ns = parse_duration(optarg)) == 0) {
+                    fprintf(stderr, "Error: invalid time budget '%s', use eg. '90s' or '5m'\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                // the budget includes the loading of the rules
+                opts.deadline_ns = monotonic_ns() + budget_ns;
+                break;
             case '?':
-                if (optopt == 'n' || optopt == 'm' || optopt == 'r' || optopt == 't' || optopt == 'f' || optopt == 'e') {
+                if (optopt == 'n' || optopt == 'm' || optopt == 'r' || optopt == 't' || optopt == 's' || optopt == 'f' || optopt == 'e' || optopt == 'P') {
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 }
                 else if (isprint (optopt)) {
                     fprintf (stderr, "Unknown option `-%c'.\n", optopt);
                 }
-                else {
+                else if (optopt != 0) {
                     fprintf (stderr, "Unknown option character `\\x%x'.\n", optopt);
                 }
                 return EXIT_FAILURE;
@@ -134,8 +540,84 @@ strcpy(available_engines[engine_count++], "coraza");
         }
     }
 
-    if (ftwengine == NULL) {
-        ftwengine = strdup(available_engines[0]);
+    if (optind < argc) {
+        if (strcmp(argv[optind], "index") == 0 && optind + 1 == argc) {
+            index_command = 1;
+        }
+        else if (strcmp(argv[optind], "minimize") == 0 && optind + 1 == argc) {
+            minimize_command = 1;
+        }
+        else {
+            fprintf(stderr, "Unknown command: %s\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opts.select_expr != NULL && opts.select_expr[0] == '@') {
+        if ((select_file = ftw_selection_read(opts.select_expr + 1)) == NULL) {
+            fprintf(stderr, "Error: can't read the selection file %s\n", opts.select_expr + 1);
+            return EXIT_FAILURE;
+        }
+        opts.select_expr = select_file;
+    }
+    if (opts.select_expr != NULL) {
+        if (strpbrk(opts.select_expr, FTW_DAEMON_SEP) != NULL || (opts.selection = ftw_selection_compile(opts.select_expr, &errormsg)) == NULL) {
+            fprintf(stderr, "Error: invalid selection '%s': %s\n", opts.select_expr, (errormsg != NULL) ? errormsg : "invalid character");
+            return EXIT_FAILURE;
+        }
+    }
+    {
+        int modes = ((daemon_mode == 1) ? FTW_MODE_DAEMON : 0) | ((watch_mode == 1) ? FTW_MODE_WATCH : 0) | ((client_req != NULL) ? FTW_MODE_CLIENT : 0)
+                  | ((index_command == 1) ? FTW_MODE_INDEX : 0) | ((list_mode == 1) ? FTW_MODE_LIST : 0) | ((minimize_command == 1) ? FTW_MODE_MINIMIZE : 0)
+                  | ((soak_iterations > 0) ? FTW_MODE_SOAK : 0);
+        const ftw_mode_conflict conflicts[] = {
+            {"'-M' and '-V'",                   opts.minimal_config == 1 || verify_full == 1,   FTW_MODE_DAEMON | FTW_MODE_WATCH},
+            {"the result cache",                use_cache == 1,                                 FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_MINIMIZE | FTW_MODE_SOAK},
+            {"'--journal'",                     journal_path != NULL,                           FTW_MODE_DAEMON | FTW_MODE_WATCH},
+            {"'--resume' and '--rerun-failed'", opts.journal_mode != FTW_JOURNAL_NEW,           FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_MINIMIZE | FTW_MODE_SOAK},
+            {"'--time-budget'",                 opts.deadline_ns > 0,                           FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_MINIMIZE | FTW_MODE_SOAK},
+            {"'--dedup'",                       dedup == 1,                                     FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_SOAK},
+            {"'--affected-by'",                 opts.affected_by != NULL,                       FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_MINIMIZE},
+            {"'--fired-db'",                    fired_path != NULL,                             FTW_MODE_DAEMON | FTW_MODE_WATCH},
+            {"'--sample'",                      opts.sample_arg != NULL,                        FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_CLIENT},
+            {"'minimize'",                      minimize_command == 1,                          FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_LIST},
+            {"'--timeout'",                     timeout_ns > 0,                                 FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_SOAK},
+            {"'--profile'",                     profile_path != NULL,                           FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST},
+            {"'--trace'",                       trace_path != NULL,                             FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST},
+            {"'--slowest'",                     opts.slowest > 0,                               FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST},
+            {"'--alloc-stats'",                 opts.alloc_top > 0,                             FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST},
+            {"'--perf-counters'",               opts.perf_top > 0,                              FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST},
+            {"'--soak'",                        soak_iterations > 0,                            FTW_MODE_DAEMON | FTW_MODE_WATCH | FTW_MODE_INDEX | FTW_MODE_LIST | FTW_MODE_MINIMIZE},
+        };
+        if (check_mode_conflicts(conflicts, sizeof(conflicts) / sizeof(conflicts[0]), modes) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (opts.sample_arg != NULL) {
+        int percent;
+        if (ftw_sample_size(opts.sample_arg, &percent) == 0) {
+            fprintf(stderr, "Error: invalid sample size '%s', use a percent or a number of tests\n", opts.sample_arg);
+            return EXIT_FAILURE;
+        }
+    }
+    if (socket_path == NULL) {
+        socket_path = strdup(FTWRUNNER_SOCKET);
+    }
+    if (index_path == NULL) {
+        index_path = strdup(FTWRUNNER_TESTINDEX);
+    }
+    if (client_req != NULL) {
+        int rc = ftw_daemon_client(socket_path, client_req, &opts);
+        FTW_FREE_STRING(socket_path);
+        FTW_FREE_STRING(cache_path);
+        FTW_FREE_STRING(fired_path);
+        FTW_FREE_STRING(index_path);
+        FTW_FREE_STRING(journal_path);
+        FTW_FREE_STRING(opts.ftwtest_root);
+        return (rc < 0) ? EXIT_FAILURE : rc;
+    }
+
+    if (opts.ftwengine == NULL) {
+        opts.ftwengine = strdup(available_engines[0]);
     }
     // read config, config options
     if (ftwconfig == NULL) {
@@ -161,17 +643,17 @@ strcpy(available_engines[engine_count++], "coraza");
                 yaml_item *titem;
                 if (yaml_item_get_value_by_key(yroot, (const char *)"test_whitelist", &titem) == YAML_KEYSEARCH_FOUND && titem->type == YAML_VALTYPE_LIST) {
                     int i;
-                    test_whitelist = calloc(titem->value.list->length+1, sizeof(char *));
-                    if (test_whitelist == NULL) {
+                    opts.test_whitelist = calloc(titem->value.list->length+1, sizeof(char *));
+                    if (opts.test_whitelist == NULL) {
                         fprintf(stderr, "Error: out of memory!\n");
                         return EXIT_FAILURE;
                     }
                     for (i = 0; i < titem->value.list->length; i++) {
-                        test_whitelist[i] = strdup(titem->value.list->list[i]->value.sval);
+                        opts.test_whitelist[i] = strdup(titem->value.list->list[i]->value.sval);
                     }
-                    qsort(test_whitelist, titem->value.list->length, sizeof(char *), walkcmp);
-                    test_whitelist_count = titem->value.list->length;
-                    test_whitelist[i] = NULL;
+                    qsort(opts.test_whitelist, titem->value.list->length, sizeof(char *), walkcmp);
+                    opts.test_whitelist_count = titem->value.list->length;
+                    opts.test_whitelist[i] = NULL;
                 }
                 yaml_item_free(yroot);
             }
@@ -186,12 +668,12 @@ strcpy(available_engines[engine_count++], "coraza");
     else {
         int i = 0;
         for(i = 0; i < engine_count; i++) {
-            if (ftwengine != NULL && strcmp(ftwengine, available_engines[i]) == 0) {
+            if (opts.ftwengine != NULL && strcmp(opts.ftwengine, available_engines[i]) == 0) {
                 break;
             }
         }
         if (i == engine_count) {
-            fprintf(stderr, "Error: engine %s not available!\n", ftwengine);
+            fprintf(stderr, "Error: engine %s not available!\n", opts.ftwengine);
             return EXIT_FAILURE;
         }
     }
@@ -202,115 +684,386 @@ strcpy(available_engines[engine_count++], "coraza");
     }
     else {
         yaml_item *titem;
-        if (ftwtest_root == NULL) {
+        if (opts.ftwtest_root == NULL) {
             if (yaml_item_get_value_by_key(yroot, (const char *)"ftwtest_root", &titem) == YAML_KEYSEARCH_FOUND && titem->type == YAML_VALTYPE_STRING) {
-                ftwtest_root = strdup(titem->value.sval);
+                opts.ftwtest_root = strdup(titem->value.sval);
             }
         }
-        if (modsecurity_config == NULL) {
+        if (opts.modsecurity_config == NULL) {
             if (yaml_item_get_value_by_key(yroot, (const char *)"modsecurity_config", &titem) == YAML_KEYSEARCH_FOUND && titem->type == YAML_VALTYPE_STRING) {
-                modsecurity_config = strdup(titem->value.sval);
+                opts.modsecurity_config = strdup(titem->value.sval);
             }
         }
         if (yaml_item_get_value_by_key(yroot, (const char *)"test_whitelist", &titem) == YAML_KEYSEARCH_FOUND && titem->type == YAML_VALTYPE_LIST) {
             int i;
-            test_whitelist = calloc(titem->value.list->length+1, sizeof(char *));
-            if (test_whitelist == NULL) {
+            opts.test_whitelist = calloc(titem->value.list->length+1, sizeof(char *));
+            if (opts.test_whitelist == NULL) {
                 fprintf(stderr, "Error: out of memory!\n");
                 return EXIT_FAILURE;
             }
             for (i = 0; i < titem->value.list->length; i++) {
-                test_whitelist[i] = strdup(titem->value.list->list[i]->value.sval);
+                opts.test_whitelist[i] = strdup(titem->value.list->list[i]->value.sval);
             }
-            qsort(test_whitelist, titem->value.list->length, sizeof(char *), walkcmp);
-            test_whitelist_count = titem->value.list->length;
-            test_whitelist[i] = NULL;
+            qsort(opts.test_whitelist, titem->value.list->length, sizeof(char *), walkcmp);
+            opts.test_whitelist_count = titem->value.list->length;
+            opts.test_whitelist[i] = NULL;
         }
         yaml_item_free(yroot);
     }
-    if (modsecurity_config == NULL) {
+    if (opts.modsecurity_config == NULL) {
         fprintf(stderr, "Error: modsecurity_config not set!\n");
         return EXIT_FAILURE;
     }
-    if (ftwtest_root == NULL) {
+    if (opts.ftwtest_root == NULL) {
         fprintf(stderr, "Error: ftwtest_root not set!\n");
         return EXIT_FAILURE;
     }
+    if (opts.slowest > 0 && (opts.latency = calloc(1, sizeof(ftw_latency))) == NULL) {
+        fprintf(stderr, "Error: out of memory!\n");
+        return EXIT_FAILURE;
+    }
+    if (opts.alloc_top > 0) {
+        if (ftw_alloc_available() == 0) {
+            fprintf(stderr, "Error: '--alloc-stats' needs the GNU C library and a build with 'configure --enable-alloc-stats'!\n");
+            return EXIT_FAILURE;
+        }
+        if ((opts.allocs = calloc(1, sizeof(ftw_alloc_report))) == NULL) {
+            fprintf(stderr, "Error: out of memory!\n");
+            return EXIT_FAILURE;
+        }
+        ftw_alloc_enable();
+    }
+    if (opts.perf_top > 0) {
+        if ((opts.perf = ftw_perf_open()) == NULL) {
+            fprintf(stderr, "Error: the performance counters can't be opened, check /proc/sys/kernel/perf_event_paranoid!\n");
+            return EXIT_FAILURE;
+        }
+        if (opts.perf->hardware == 0) {
+            fprintf(stderr, "Note: no hardware performance counters, the software counters are used\n");
+        }
+        if ((opts.perf_report = calloc(1, sizeof(ftw_perf_report))) == NULL) {
+            fprintf(stderr, "Error: out of memory!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (soak_iterations > 0) {
+        if (ftw_alloc_heap_available() == 0) {
+            fprintf(stderr, "Error: '--soak' needs the GNU C library!\n");
+            return EXIT_FAILURE;
+        }
+        if ((opts.soak = ftw_soak_new(soak_iterations)) == NULL) {
+            fprintf(stderr, "Error: out of memory!\n");
+            return EXIT_FAILURE;
+        }
+        if (opts.soak_threshold == 0) {
+            opts.soak_threshold = FTW_SOAK_THRESHOLD;
+        }
+        ftw_alloc_enable();
+    }
+    // the transactions run in child processes, their work isn't seen here
+    if (timeout_ns > 0 && (opts.perf_top > 0 || profile_path != NULL)) {
+        fprintf(stderr, "Error: '--timeout' can't be used with '--perf-counters' and '--profile'!\n");
+        return EXIT_FAILURE;
+    }
+    if (trace_path != NULL) {
+        if ((opts.trace = ftw_trace_open(trace_path, main_start)) == NULL) {
+            fprintf(stderr, "Error: can't write the trace %s\n", trace_path);
+            return EXIT_FAILURE;
+        }
+    }
+    if (profile_path != NULL) {
+        if ((opts.profile = calloc(1, sizeof(ftw_profile))) == NULL) {
+            fprintf(stderr, "Error: out of memory!\n");
+            return EXIT_FAILURE;
+        }
+        opts.profile->start_ns = main_start;
+    }
+    if (opts.rule_groups > 1 && verify_full == 0) {
+        fprintf(stderr, "Error: '-P' is a check of the merged rule set, use it with '-V'!\n");
+        return EXIT_FAILURE;
+    }
+    if (verify_full == 1 && opts.rule_groups < 2) {
+        opts.minimal_config = 1;
+    }
+    if (opts.rule_groups > 1 && strcmp(opts.ftwengine, "modsecurity") != 0) {
+        fprintf(stderr, "Error: loading the rules in groups is supported only by the modsecurity engine!\n");
+        return EXIT_FAILURE;
+    }
+    if (opts.minimal_config == 1 && opts.rule_test == 0) {
+        fprintf(stderr, "Error: minimal config needs a rule, use '-r'!\n");
+        return EXIT_FAILURE;
+    }
     // END read config, config options
 
-    char rootdir[1024];
-    strcpy(rootdir, ftwtest_root);
-    walkdir(rootdir, &tests, &test_count);
+    if (index_command == 1 || list_mode == 1) {
+        char            rootdir[1024];
+        ftw_testindex * index;
+        ftw_testindex * updated;
+
+        snprintf(rootdir, sizeof(rootdir), "%s", opts.ftwtest_root);
+        walkdir(rootdir, &tests, &test_count);
+        index   = ftw_testindex_load(index_path, opts.ftwtest_root);
+        updated = ftw_testindex_update(index, opts.ftwtest_root, tests, test_count);
+        if (updated == NULL) {
+            fprintf(stderr, "Error: out of memory!\n");
+            failed_count = EXIT_FAILURE;
+        }
+        else if (index_command == 1) {
+            if (ftw_testindex_save(updated, index_path) != 0) {
+                fprintf(stderr, "Error: can't write the test index %s\n", index_path);
+                failed_count = EXIT_FAILURE;
+            }
+            else {
+                printf("Indexed %u tests of %u files (%u parsed) into %s\n", updated->tests_count, updated->files_count, updated->parsed, index_path);
+            }
+        }
+        else {
+            if (index == NULL) {
+                fprintf(stderr, "Note: no test index in %s, use the 'index' command to create it\n", index_path);
+            }
+            if (opts.sample_arg != NULL && (opts.sample = ftw_sample_tests(&opts, updated, seed)) == NULL) {
+                fprintf(stderr, "Error: out of memory!\n");
+                failed_count = EXIT_FAILURE;
+            }
+            else {
+                ftw_testindex_list(&opts, updated);
+                if (opts.sample != NULL) {
+                    ftw_sample_show(opts.sample);
+                }
+            }
+        }
+        ftw_testindex_free(index);
+        ftw_testindex_free(updated);
+        for (unsigned i = 0; i < test_count; i++) {
+            free(tests[i]);
+        }
+        free(tests);
+        tests = NULL;
+    }
+
+    else if (daemon_mode == 1) {
+        ftw_daemon_ctx  daemon;
+        ftw_ruleindex * ruleindex = ftw_run_index_rules(&opts, 1);
+
+        daemon.opts             = &opts;
+        daemon.config_signature = ftw_run_config_signature(ruleindex, opts.modsecurity_config);
+        daemon.engine           = ftw_run_load_engine(&opts, ruleindex, &errormsg);
+        if (daemon.engine == NULL) {
+            fprintf(stderr, "ftwrunner init error: %s\n", errormsg);
+            failed_count = EXIT_FAILURE;
+        }
+        else {
+            failed_count = (ftw_daemon_serve(socket_path, ftw_daemon_handler, &daemon) < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+            ftw_engine_free(daemon.engine);
+        }
+    }
+    else {
+        char rootdir[1024];
+        part_start = monotonic_ns();
+        strcpy(rootdir, opts.ftwtest_root);
+        walkdir(rootdir, &tests, &test_count);
+        if (opts.sample_arg != NULL) {
+            // the sample needs every test, the test index spares the parsing
+            ftw_testindex * index   = ftw_testindex_load(index_path, opts.ftwtest_root);
+            ftw_testindex * updated = ftw_testindex_update(index, opts.ftwtest_root, tests, test_count);
+
+            if (updated == NULL || (opts.sample = ftw_sample_tests(&opts, updated, seed)) == NULL) {
+                fprintf(stderr, "Error: out of memory!\n");
+                exit(EXIT_FAILURE);
+            }
+            if (index == NULL) {
+                fprintf(stderr, "Note: no test index in %s, use the 'index' command to create it\n", index_path);
+            }
+            ftw_testindex_free(index);
+            ftw_testindex_free(updated);
+        }
+        if ((opts.rule_test != 0 || opts.selection != NULL || opts.sample != NULL) && watch_mode == 0) {
+            ftw_testindex_select_files(&opts, index_path, tests, &test_count);
+        }
+        if (opts.profile != NULL) {
+            opts.profile->part_ns[FTW_PROFILE_DISCOVERY] = monotonic_ns() - part_start;
+        }
+        if (opts.trace != NULL) {
+            ftw_trace_span(opts.trace, "run", "discovery", part_start, monotonic_ns(), NULL);
+        }
+    }
 
     if (tests != NULL) {
 
-        ftw_engine *engine = NULL;
+        ftw_engine    * engine      = NULL;
+        ftw_engine    * engine_full = NULL;
+
+        ftw_ruleindex * ruleindex   = ftw_run_index_rules(&opts, (use_cache == 1 || opts.affected_by != NULL || opts.deadline_ns > 0) ? 1 : 0);
+        ftw_cache     * cache       = NULL;
+        // the config files are hashed before the engine takes the index
+        unsigned long long env_hash    = (use_cache == 1) ? cache_env_hash(&opts, ruleindex) : 0;
+
+        if (opts.affected_by != NULL || fired_path != NULL || minimize_command == 1 || opts.deadline_ns > 0) {
+            opts.fired = ftw_fired_db_open((fired_path != NULL) ? fired_path : FTWRUNNER_FIRED);
+        }
+        if (opts.affected_by == NULL && opts.deadline_ns > 0 && ruleindex != NULL) {
+            // the tests of the uncommitted changes run first, it's not an error if there is no git repository
+            if (ftw_impact_changed_ids(ruleindex, "git", opts.modsecurity_config, &opts.affected_ids, &opts.affected_ids_count, &opts.affected_all) != 0) {
+                opts.affected_ids_count = 0;
+            }
+        }
+        if (opts.affected_by != NULL) {
+            if (ruleindex == NULL || ftw_impact_changed_ids(ruleindex, opts.affected_by, opts.modsecurity_config,
+                                        &opts.affected_ids, &opts.affected_ids_count, &opts.affected_all) != 0) {
+                errormsg = "can't read the change of '--affected-by'";
+            }
+            else if (opts.affected_all == 1) {
+                printf("Affected rules: all\n");
+            }
+            else {
+                printf("Affected rules:");
+                for (unsigned int i = 0; i < opts.affected_ids_count; i++) {
+                    printf(" %u", opts.affected_ids[i]);
+                }
+                printf("%s\n", (opts.affected_ids_count == 0) ? " none" : "");
+            }
+        }
 
-        if (strcmp(ftwengine, "dummy") == 0) {
-            engine = ftw_engine_init(FTW_ENGINE_TYPE_DUMMY, modsecurity_config, &errormsg);
+        part_start = monotonic_ns();
+        if (errormsg == NULL) {
+            engine = ftw_run_load_engine(&opts, ruleindex, &errormsg);
+        }
+        else {
+            ftw_ruleindex_free(ruleindex);
+        }
+        if (engine != NULL) {
+            engine->fired       = opts.fired;
+            engine->show_phases = phase_times;
+            engine->alloc_stats = (opts.allocs != NULL) ? 1 : 0;
+            engine->heap_stats  = (opts.soak != NULL) ? 1 : 0;
+            engine->perf        = opts.perf;
+            engine->timeout_ns  = timeout_ns;
+            if (dedup == 1 && (engine->dedup = ftw_dedup_new()) == NULL) {
+                errormsg = "out of memory";
+            }
         }
-        else if (strcmp(ftwengine, "modsecurity") == 0) {
-            engine = ftw_engine_init(FTW_ENGINE_TYPE_MODSECURITY, modsecurity_config, &errormsg);
+        if (engine != NULL && use_cache == 1) {
+            const char * version = ftw_engine_version(engine);
+            cache = ftw_cache_open((cache_path != NULL) ? cache_path : FTWRUNNER_CACHE, hash_fnv1a(version, strlen(version) + 1, env_hash), reverify);
+            engine->cache = cache;
         }
-        else if (strcmp(ftwengine, "coraza") == 0) {
-            engine = ftw_engine_init(FTW_ENGINE_TYPE_CORAZA, modsecurity_config, &errormsg);
+        if (engine != NULL && watch_mode == 1) {
+            // it returns only on error
+            ftw_watch_run(&opts, &engine, tests, test_count);
+            failed_count = EXIT_FAILURE;
+            tests = NULL;
+        }
+        else if (engine != NULL && verify_full == 1) {
+            engine_full = ftw_run_engine_new(opts.ftwengine, opts.modsecurity_config, &errormsg);
+            if (errormsg == NULL) {
+                engine_full->stop_on_disruptive = opts.stop_on_disruptive;
+            }
+        }
+        if (opts.profile != NULL) {
+            opts.profile->part_ns[FTW_PROFILE_RULE_LOAD] = monotonic_ns() - part_start;
+        }
+        if (opts.trace != NULL) {
+            ftw_trace_span(opts.trace, "run", "rule loading", part_start, monotonic_ns(), NULL);
         }
         if (errormsg != NULL) {
             fprintf(stderr, "ftwrunner init error: %s\n", errormsg);
             for(int i = 0; i < test_count; i++) {
                 free(tests[i]);
             }
+            free(tests);
         }
-        else {
-            qsort(tests, test_count, sizeof(char *), walkcmp);
-            for(int i = 0; i < test_count; i++) {
-                yaml_item *yrootsub = parse_yaml(tests[i]);
-                if (yrootsub == NULL) {
-                    fprintf(stderr, "Error: failed to parse YAML file: %s\n", tests[i]);
-                    continue;
-                }
-                ftwtestcollection * collection = ftwtestcollection_new(yrootsub, rule_test, rule_test_id);
-                if (collection == NULL) {
-                    fprintf(stderr, "Error parsing file %s! (Memory allocation error)\n", tests[i]);
-                    exit(EXIT_FAILURE);
+        else if (tests != NULL) {
+            // the soak runs would repeat the results in the journal
+            if (opts.soak == NULL) {
+                opts.journal = ftw_journal_load((journal_path != NULL) ? journal_path : FTWRUNNER_JOURNAL, journal_run_hash(&opts));
+            }
+            if (opts.journal != NULL && opts.journal_mode != FTW_JOURNAL_NEW && opts.journal->count == 0) {
+                fprintf(stderr, "Note: no results of the same run in the journal %s\n", opts.journal->path);
+            }
+            else if (opts.journal != NULL && opts.journal_mode == FTW_JOURNAL_RESUME && opts.journal->complete == 1) {
+                fprintf(stderr, "Note: the last run was complete\n");
+            }
+            if (opts.journal != NULL && ftw_journal_open(opts.journal, (opts.journal_mode == FTW_JOURNAL_RESUME) ? 1 : 0) != 0) {
+                fprintf(stderr, "Warning: can't write the journal %s\n", opts.journal->path);
+            }
+            failed_count = ftw_run_tests(engine, engine_full, &opts, tests, test_count);
+            part_start   = monotonic_ns();
+            ftw_journal_free(opts.journal);
+            opts.journal = NULL;
+            if (minimize_command == 1) {
+                ftw_minimal * minimal = ftw_minimize(opts.fired);
+                const char  * path    = (minimal_path != NULL) ? minimal_path : FTWRUNNER_MINIMAL;
+
+                if (minimal == NULL || ftw_minimal_write(minimal, path) != 0) {
+                    fprintf(stderr, "Error: can't write the minimal tests %s\n", path);
+                    failed_count = EXIT_FAILURE;
                 }
-                if (collection->meta.enabled) {
-                    for(int t = 0; t < collection->test_count; t++) {
-                        ftwtest *test = collection->tests[t];
-                        if (rule_test == 0 || rule_test == collection->rule_id) {
-                            if (rule_test_id == 0 || rule_test_id == test->test_id) {
-                                for(int si = 0; si < test->stages_count; si++) {
-                                    ftw_stage *stage = test->stages[si];
-                                    char test_full_id[50];
-                                    sprintf(test_full_id, "%u-%u", collection->rule_id, test->test_id);
-                                    int wl = qsearch(test_whitelist, test_whitelist_count, test_full_id);
-                                    engine_runtest(engine, collection->meta.enabled, ((wl >= 0) ? 1 : 0), test_full_id, stage, debug, verbose);
-                                }
-                            }
-                        }
-                    }
+                else {
+                    printf("MINIMAL TESTS:          %u of %u (%u fired rules), use '-s @%s'\n", minimal->count, minimal->candidates, minimal->ids_count, path);
+                    printf("===============================\n");
                 }
-                ftwtestcollection_free(collection);
-                yaml_item_free(yrootsub);
-                free(tests[i]);
+                ftw_minimal_free(minimal);
+            }
+        }
+        if (cache != NULL) {
+            if (ftw_cache_save(cache) != 0) {
+                fprintf(stderr, "Warning: can't write the result cache %s\n", cache->path);
             }
-            ftw_engine_show_result(engine);
-            logCbClearLog();
+            ftw_cache_free(cache);
+        }
+        if (opts.fired != NULL) {
+            if (errormsg == NULL && ftw_fired_db_save(opts.fired) != 0) {
+                fprintf(stderr, "Warning: can't write the fired rules %s\n", opts.fired->path);
+            }
+            ftw_fired_db_free(opts.fired);
         }
         if (engine != NULL) {
-            failed_count = engine->cnt_failed;
             ftw_engine_free(engine);
         }
-        free(tests);
+        if (engine_full != NULL) {
+            ftw_engine_free(engine_full);
+        }
+        if (opts.trace != NULL) {
+            ftw_trace_span(opts.trace, "run", "teardown", part_start, monotonic_ns(), NULL);
+        }
+        if (opts.profile != NULL) {
+            opts.profile->part_ns[FTW_PROFILE_TEARDOWN] = monotonic_ns() - part_start;
+            ftw_profile_show(opts.profile);
+            if (ftw_profile_write(opts.profile, profile_path) != 0) {
+                fprintf(stderr, "Warning: can't write the profile %s\n", profile_path);
+            }
+        }
     }
-    else {
+    else if (daemon_mode == 0 && index_command == 0 && list_mode == 0) {
         printf("No tests found!\n");
     }
 
     FTW_FREE_STRING(ftwconfig);
-    FTW_FREE_STRING(modsecurity_config);
-    FTW_FREE_STRING(ftwtest_root);
-    FTW_FREE_STRING(ftwengine);
-    FTW_FREE_STRINGLIST(test_whitelist);
+    FTW_FREE_STRING(overrides);
+    FTW_FREE_STRING(socket_path);
+    FTW_FREE_STRING(cache_path);
+    FTW_FREE_STRING(fired_path);
+    FTW_FREE_STRING(index_path);
+    FTW_FREE_STRING(journal_path);
+    FTW_FREE_STRING(minimal_path);
+    FTW_FREE_STRING(select_file);
+    FTW_FREE_STRING(profile_path);
+    if (ftw_trace_close(opts.trace) != 0) {
+        fprintf(stderr, "Warning: can't write the trace %s\n", trace_path);
+    }
+    FTW_FREE_STRING(trace_path);
+    ftw_profile_free(opts.profile);
+    ftw_latency_free(opts.latency);
+    ftw_alloc_report_free(opts.allocs);
+    ftw_soak_free(opts.soak);
+    ftw_perf_report_free(opts.perf_report);
+    ftw_perf_close(opts.perf);
+    free(opts.affected_ids);
+    ftw_selection_free(opts.selection);
+    ftw_sample_free(opts.sample);
+    FTW_FREE_STRING(opts.modsecurity_config);
+    FTW_FREE_STRING(opts.ftwtest_root);
+    FTW_FREE_STRING(opts.ftwengine);
+    FTW_FREE_STRINGLIST(opts.test_whitelist);
     return failed_count;
 }
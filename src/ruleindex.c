@@ -0,0 +1,692 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ruleindex.c
+// functions for indexing the rules of a WAF config
+//
+// the index follows the 'Include' directives of the main config file
+// (relative paths are resolved to the directory of the including file,
+// like the engines do), and collects the declared rules:
+//
+// SecRule REQUEST_METHOD "!@within %{tx.allowed_methods}" "id:911100,phase:1,block,..."
+//
+// only the SecRule and SecAction directives with an 'id' are indexed;
+// the chained rules are part of their chain starter
+//
+// the data files of the operators are collected too, they are resolved
+// to the directory of the config file:
+//
+// SecRule REQUEST_HEADERS:User-Agent "@pmFromFile scanners-user-agents.data" "id:913100,..."
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <limits.h>
+#include <glob.h>
+#include <libgen.h>
+#include <strings.h>
+
+#include "ruleindex.h"
+
+#define RULEINDEX_MAXARGS 8
+
+static int ruleidcmp(const void *p1, const void *p2) {
+    unsigned int id1 = ((const ftw_rule *)p1)->id;
+    unsigned int id2 = ((const ftw_rule *)p2)->id;
+    return (id1 > id2) - (id1 < id2);
+}
+
+// split a directive line to arguments in place
+// the arguments are separated by whitespaces, the quotes are removed
+// returns the number of the arguments
+static int ruleindex_split_args(char * line, char ** args, int maxargs) {
+    int    argc = 0;
+    char * p    = line;
+
+    while (*p != '\0' && argc < maxargs) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (*p == '"' || *p == '\'') {
+            char   quote = *p++;
+            char * dst   = p;
+            args[argc++] = p;
+            while (*p != '\0' && *p != quote) {
+                if (*p == '\\' && *(p+1) != '\0') {
+                    *dst++ = *p++;
+                }
+                *dst++ = *p++;
+            }
+            if (*p != '\0') {
+                p++;
+            }
+            *dst = '\0';
+        }
+        else {
+            args[argc++] = p;
+            while (*p != '\0' && !isspace((unsigned char)*p)) {
+                p++;
+            }
+            if (*p != '\0') {
+                *p++ = '\0';
+            }
+        }
+    }
+    return argc;
+}
+
+// parse the action list of a rule
+// sets the id (0 if there is no id), the phase and the chain flag
+static void ruleindex_parse_actions(const char * actions, unsigned int * id, int * phase, int * chain) {
+    const char * p = actions;
+
+    *id    = 0;
+    *phase = RULEINDEX_DEFAULT_PHASE;
+    *chain = 0;
+
+    while (*p != '\0') {
+        const char * end = p;
+        int inquote = 0;
+        // actions are separated by commas, except in quoted values
+        while (*end != '\0' && (inquote == 1 || *end != ',')) {
+            if (*end == '\'') {
+                inquote = !inquote;
+            }
+            end++;
+        }
+        while (p < end && isspace((unsigned char)*p)) {
+            p++;
+        }
+        size_t len = end - p;
+        if (len > 3 && strncasecmp(p, "id:", 3) == 0) {
+            const char * v = p + 3;
+            while (*v == '\'' || isspace((unsigned char)*v)) {
+                v++;
+            }
+            *id = strtoul(v, NULL, 10);
+        }
+        else if (len > 6 && strncasecmp(p, "phase:", 6) == 0) {
+            const char * v = p + 6;
+            while (*v == '\'' || isspace((unsigned char)*v)) {
+                v++;
+            }
+            if (isdigit((unsigned char)*v)) {
+                *phase = atoi(v);
+            }
+            else if (strncasecmp(v, "request", 7) == 0) {
+                *phase = 2;
+            }
+            else if (strncasecmp(v, "response", 8) == 0) {
+                *phase = 4;
+            }
+            else if (strncasecmp(v, "logging", 7) == 0) {
+                *phase = 5;
+            }
+        }
+        else if (len >= 5 && strncasecmp(p, "chain", 5) == 0 && (len == 5 || isspace((unsigned char)p[5]))) {
+            *chain = 1;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+static int ruleindex_add_rule(ftw_ruleindex * index, unsigned int id, int phase, unsigned int file, unsigned int line_start, unsigned int line_end) {
+    ftw_rule * rules = realloc(index->rules, sizeof(ftw_rule) * (index->rules_count + 1));
+    if (rules == NULL) {
+        return -1;
+    }
+    index->rules = rules;
+    index->rules[index->rules_count].id    = id;
+    index->rules[index->rules_count].phase = phase;
+    index->rules[index->rules_count].file  = file;
+    index->rules[index->rules_count].line_start = line_start;
+    index->rules[index->rules_count].line_end   = line_end;
+    index->rules_count++;
+    return 0;
+}
+
+// add a string to a list
+static int ruleindex_add_string(char *** list, unsigned int * count, const char * str) {
+    char ** tmp = realloc(*list, sizeof(char *) * (*count + 1));
+    if (tmp == NULL) {
+        return -1;
+    }
+    *list = tmp;
+    if (((*list)[*count] = strdup(str)) == NULL) {
+        return -1;
+    }
+    (*count)++;
+    return 0;
+}
+
+// the operators with data file arguments
+static const char * ruleindex_file_operators[] = {
+    "@pmFromFile", "@pmf", "@ipMatchFromFile", "@ipMatchF", NULL
+};
+
+// find a string in a list
+static int ruleindex_has_string(char ** list, unsigned int count, const char * str) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (strcmp(list[i], str) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// collect the data files of the operator of a rule, to the config file and
+// to the index
+// the files are resolved to the directory of the config file; the remote
+// ones (https://...) are left out
+static int ruleindex_parse_datafiles(ftw_ruleindex * index, unsigned int fileidx, const char * config, const char * operator) {
+    ftw_rulefile * rulefile = &index->files[fileidx];
+    const char * p = operator;
+    size_t       oplen;
+    int          known = 0;
+
+    if (*p == '!') {
+        p++;
+    }
+    oplen = strcspn(p, " \t");
+    for (int i = 0; ruleindex_file_operators[i] != NULL && known == 0; i++) {
+        known = (strlen(ruleindex_file_operators[i]) == oplen && strncasecmp(p, ruleindex_file_operators[i], oplen) == 0) ? 1 : 0;
+    }
+    if (known == 0) {
+        return 0;
+    }
+    p += oplen;
+    while (*p != '\0') {
+        char   file[256];
+        char   path[PATH_MAX];
+        char   resolved[PATH_MAX];
+        size_t len;
+
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        len = strcspn(p, " \t");
+        if (len == 0 || len >= sizeof(file)) {
+            p += len;
+            continue;
+        }
+        memcpy(file, p, len);
+        file[len] = '\0';
+        p += len;
+        if (strstr(file, "://") != NULL) {
+            continue;
+        }
+        if (file[0] == '/') {
+            snprintf(path, PATH_MAX, "%s", file);
+        }
+        else {
+            char * configcopy = strdup(config);
+            if (configcopy == NULL) {
+                return -1;
+            }
+            snprintf(path, PATH_MAX, "%s/%s", dirname(configcopy), file);
+            free(configcopy);
+        }
+        if (realpath(path, resolved) == NULL) {
+            snprintf(resolved, PATH_MAX, "%s", path);
+        }
+        if (ruleindex_has_string(rulefile->data_files, rulefile->data_files_count, resolved) == 0
+            && ruleindex_add_string(&rulefile->data_files, &rulefile->data_files_count, resolved) != 0) {
+            return -1;
+        }
+        if (ruleindex_has_string(index->data_files, index->data_files_count, resolved) == 0
+            && ruleindex_add_string(&index->data_files, &index->data_files_count, resolved) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// collect the 'skipAfter' targets of an action list
+static int ruleindex_parse_skipafter(ftw_rulefile * file, const char * actions) {
+    const char * p = actions;
+
+    while ((p = strstr(p, "skipAfter:")) != NULL) {
+        char   target[256];
+        size_t len = 0;
+        p += 10;
+        while (*p == '\'' || isspace((unsigned char)*p)) {
+            p++;
+        }
+        while (*p != '\0' && *p != '\'' && *p != ',' && !isspace((unsigned char)*p) && len < sizeof(target) - 1) {
+            target[len++] = *p++;
+        }
+        target[len] = '\0';
+        if (len > 0 && ruleindex_add_string(&file->skip_targets, &file->skip_targets_count, target) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// read the next statement of a config file
+// the continuation lines are joined, the statement is placed in *stmt
+// *lineno counts the read lines, *first is the first line of the statement
+// returns 1 if a statement was read, 0 at the end of the file, -1 on error
+static int ruleindex_next_statement(FILE * fp, char ** line, size_t * linesize, char ** stmt, size_t * stmtlen, unsigned int * lineno, unsigned int * first) {
+    *stmtlen = 0;
+    *first   = *lineno + 1;
+    while (getline(line, linesize, fp) != -1) {
+        size_t len = strlen(*line);
+        (*lineno)++;
+        while (len > 0 && isspace((unsigned char)(*line)[len-1])) {
+            (*line)[--len] = '\0';
+        }
+        int cont = (len > 0 && (*line)[len-1] == '\\');
+        if (cont) {
+            (*line)[--len] = '\0';
+        }
+        char * tmp = realloc(*stmt, *stmtlen + len + 1);
+        if (tmp == NULL) {
+            return -1;
+        }
+        *stmt = tmp;
+        memcpy(*stmt + *stmtlen, *line, len + 1);
+        *stmtlen += len;
+        if (!cont) {
+            return 1;
+        }
+    }
+    return (*stmtlen > 0) ? 1 : 0;
+}
+
+// resolve the pattern of an 'Include' directive
+// relative paths are relative to the directory of the including file
+// returns 0 if one or more files found
+static int ruleindex_glob_include(const char * parent, const char * pattern, glob_t * globbuf) {
+    char fullpattern[PATH_MAX];
+
+    if (pattern[0] == '/') {
+        snprintf(fullpattern, PATH_MAX, "%s", pattern);
+    }
+    else {
+        char * parentcopy = strdup(parent);
+        if (parentcopy == NULL) {
+            return -1;
+        }
+        snprintf(fullpattern, PATH_MAX, "%s/%s", dirname(parentcopy), pattern);
+        free(parentcopy);
+    }
+    if (glob(fullpattern, 0, NULL, globbuf) != 0) {
+        fprintf(stderr, "Warning: included file(s) not found: %s\n", fullpattern);
+        return 1;
+    }
+    return 0;
+}
+
+// open a config file and resolve its path
+static FILE * ruleindex_open(const char * path, char * resolved, int depth) {
+    FILE * fp;
+
+    if (depth > RULEINDEX_MAXDEPTH) {
+        fprintf(stderr, "Error: too deep include nesting: %s\n", path);
+        return NULL;
+    }
+    if (realpath(path, resolved) == NULL) {
+        snprintf(resolved, PATH_MAX, "%s", path);
+    }
+    if ((fp = fopen(resolved, "r")) == NULL) {
+        fprintf(stderr, "Error: can't open config file: %s\n", resolved);
+    }
+    return fp;
+}
+
+// read a config file and index its rules
+static int ruleindex_parse_file(ftw_ruleindex * index, const char * path, int depth) {
+    FILE         * fp;
+    char         * line     = NULL;
+    size_t         linesize = 0;
+    char         * stmt     = NULL;
+    size_t         stmtlen  = 0;
+    int            in_chain = 0;
+    int            rc       = 0;
+    unsigned int   fileidx;
+    unsigned int   lineno   = 0;
+    unsigned int   start;
+    int            chained  = -1;   // the rule of the current chain
+    char           resolved[PATH_MAX];
+
+    if ((fp = ruleindex_open(path, resolved, depth)) == NULL) {
+        return -1;
+    }
+
+    ftw_rulefile * files = realloc(index->files, sizeof(ftw_rulefile) * (index->files_count + 1));
+    if (files == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    index->files = files;
+    fileidx = index->files_count++;
+    memset(&index->files[fileidx], 0, sizeof(ftw_rulefile));
+    index->files[fileidx].path = strdup(resolved);
+
+    while (rc == 0 && (rc = ruleindex_next_statement(fp, &line, &linesize, &stmt, &stmtlen, &lineno, &start)) == 1) {
+        char * args[RULEINDEX_MAXARGS];
+        char * p    = stmt;
+        rc = 0;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        int argc = ruleindex_split_args(p, args, RULEINDEX_MAXARGS);
+        const char * actions = NULL;
+
+        if (argc >= 2 && strcasecmp(args[0], "Include") == 0) {
+            glob_t globbuf;
+            index->files[fileidx].includes++;
+            if (ruleindex_glob_include(resolved, args[1], &globbuf) == 0) {
+                // note: index->files can be reallocated by the recursion
+                for (size_t i = 0; i < globbuf.gl_pathc && rc == 0; i++) {
+                    rc = ruleindex_parse_file(index, globbuf.gl_pathv[i], depth + 1);
+                }
+                globfree(&globbuf);
+            }
+        }
+        else if (argc >= 2 && strcasecmp(args[0], "SecMarker") == 0) {
+            rc = ruleindex_add_string(&index->files[fileidx].markers, &index->files[fileidx].markers_count, args[1]);
+        }
+        else if (argc >= 4 && strcasecmp(args[0], "SecRule") == 0) {
+            actions = args[3];
+            rc = ruleindex_parse_datafiles(index, fileidx, resolved, args[2]);
+        }
+        else if (argc >= 2 && strcasecmp(args[0], "SecAction") == 0) {
+            actions = args[1];
+        }
+        else if (argc >= 3 && strcasecmp(args[0], "SecRule") == 0) {
+            // chained rule without actions
+            rc = ruleindex_parse_datafiles(index, fileidx, resolved, args[2]);
+            if (in_chain == 1 && chained >= 0) {
+                index->rules[chained].line_end = lineno;
+            }
+            in_chain = 0;
+        }
+        if (actions != NULL && rc == 0) {
+            unsigned int id;
+            int phase, chain;
+            ruleindex_parse_actions(actions, &id, &phase, &chain);
+            if (in_chain == 0 && id > 0) {
+                rc = ruleindex_add_rule(index, id, phase, fileidx, start, lineno);
+                chained = index->rules_count - 1;
+            }
+            else if (in_chain == 0) {
+                chained = -1;
+            }
+            else if (chained >= 0) {
+                index->rules[chained].line_end = lineno;
+            }
+            if (rc == 0) {
+                rc = ruleindex_parse_skipafter(&index->files[fileidx], actions);
+            }
+            in_chain = chain;
+        }
+    }
+
+    free(line);
+    free(stmt);
+    fclose(fp);
+    return rc;
+}
+
+// create a new rule index from the main config file
+// returns NULL if the config can't be read
+ftw_ruleindex * ftw_ruleindex_new(const char * main_rule_uri) {
+    ftw_ruleindex * index = calloc(1, sizeof(ftw_ruleindex));
+
+    if (index == NULL) {
+        return NULL;
+    }
+    if (ruleindex_parse_file(index, main_rule_uri, 0) != 0) {
+        ftw_ruleindex_free(index);
+        return NULL;
+    }
+    qsort(index->rules, index->rules_count, sizeof(ftw_rule), ruleidcmp);
+    return index;
+}
+
+// free the rule index
+void ftw_ruleindex_free(ftw_ruleindex * index) {
+    if (index != NULL) {
+        for (unsigned int i = 0; i < index->files_count; i++) {
+            free(index->files[i].path);
+            for (unsigned int m = 0; m < index->files[i].markers_count; m++) {
+                free(index->files[i].markers[m]);
+            }
+            free(index->files[i].markers);
+            for (unsigned int m = 0; m < index->files[i].skip_targets_count; m++) {
+                free(index->files[i].skip_targets[m]);
+            }
+            free(index->files[i].skip_targets);
+            for (unsigned int m = 0; m < index->files[i].data_files_count; m++) {
+                free(index->files[i].data_files[m]);
+            }
+            free(index->files[i].data_files);
+        }
+        free(index->files);
+        free(index->rules);
+        for (unsigned int i = 0; i < index->data_files_count; i++) {
+            free(index->data_files[i]);
+        }
+        free(index->data_files);
+        free(index);
+    }
+}
+
+// find a data file of the operators by its resolved path
+// returns 1 if a rule of the config uses the file
+int ftw_ruleindex_is_data_file(const ftw_ruleindex * index, const char * path) {
+    return ruleindex_has_string(index->data_files, index->data_files_count, path);
+}
+
+// does a config file use a data file, both by their resolved paths
+int ftw_ruleindex_file_uses(const ftw_ruleindex * index, unsigned int file, const char * data_file) {
+    return ruleindex_has_string(index->files[file].data_files, index->files[file].data_files_count, data_file);
+}
+
+// find a config file by its resolved path
+// returns the index of the file, or -1 if it is not part of the config
+int ftw_ruleindex_find_file(const ftw_ruleindex * index, const char * path) {
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        if (strcmp(index->files[i].path, path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// find the file which declares a marker
+static int ruleindex_find_marker(const ftw_ruleindex * index, const char * marker) {
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        for (unsigned int m = 0; m < index->files[i].markers_count; m++) {
+            if (strcmp(index->files[i].markers[m], marker) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// CRS rule files, which must be loaded for every test:
+// exclusions, initialization, blocking evaluation and correlation
+static const int ruleindex_crs_infra[] = {900, 901, 949, 959, 980, 999};
+
+// check whether a file is a CRS rule file, which can be left out of
+// a minimal config, eg. REQUEST-942-APPLICATION-ATTACK-SQLI.conf
+int ftw_ruleindex_is_optional_file(const char * path) {
+    const char * base = strrchr(path, '/');
+    int          num  = 0;
+    int          n    = 0;
+
+    base = (base == NULL) ? path : base + 1;
+    if (sscanf(base, "REQUEST-%3d-%n", &num, &n) != 1 && sscanf(base, "RESPONSE-%3d-%n", &num, &n) != 1) {
+        return 0;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(ruleindex_crs_infra) / sizeof(ruleindex_crs_infra[0]); i++) {
+        if (num == ruleindex_crs_infra[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// write the reduced copy of a container file (a file with 'Include' directives)
+// the kept files are included with their absolute path, the other
+// directives of the container are copied if directives is 1
+static int ruleindex_write_file(const ftw_ruleindex * index, const char * path, const int * keep, int directives, FILE * out, int depth) {
+    FILE   * fp;
+    char   * line     = NULL;
+    size_t   linesize = 0;
+    char   * stmt     = NULL;
+    size_t   stmtlen  = 0;
+    int      rc       = 0;
+    unsigned lineno   = 0;
+    unsigned start;
+    char     resolved[PATH_MAX];
+
+    if ((fp = ruleindex_open(path, resolved, depth)) == NULL) {
+        return -1;
+    }
+    fprintf(out, "# %s\n", resolved);
+    while (rc == 0 && (rc = ruleindex_next_statement(fp, &line, &linesize, &stmt, &stmtlen, &lineno, &start)) == 1) {
+        char * args[RULEINDEX_MAXARGS];
+        char * p = stmt;
+        rc = 0;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        if (strncasecmp(p, "Include", 7) != 0 || !isspace((unsigned char)p[7])) {
+            if (directives == 1) {
+                fprintf(out, "%s\n", p);
+            }
+            continue;
+        }
+        glob_t globbuf;
+        if (ruleindex_split_args(p, args, RULEINDEX_MAXARGS) < 2 || ruleindex_glob_include(resolved, args[1], &globbuf) != 0) {
+            continue;
+        }
+        for (size_t i = 0; i < globbuf.gl_pathc && rc == 0; i++) {
+            char child[PATH_MAX];
+            if (realpath(globbuf.gl_pathv[i], child) == NULL) {
+                continue;
+            }
+            int fi = ftw_ruleindex_find_file(index, child);
+            if (fi < 0) {
+                continue;
+            }
+            if (index->files[fi].includes > 0) {
+                rc = ruleindex_write_file(index, child, keep, directives, out, depth + 1);
+            }
+            else if (keep[fi] == 1) {
+                fprintf(out, "Include \"%s\"\n", child);
+            }
+        }
+        globfree(&globbuf);
+    }
+    free(line);
+    free(stmt);
+    fclose(fp);
+    return rc;
+}
+
+// write a config, which includes only the kept files (see ftw_ruleindex_keep_minimal())
+// keep is indexed like the files of the index, directives controls whether
+// the own directives of the container files are copied
+// returns the number of the included files, or -1 on error
+int ftw_ruleindex_write(const ftw_ruleindex * index, const int * keep, int directives, FILE * out) {
+    int kept = 0;
+
+    if (index->files[0].includes == 0) {
+        // single file config
+        fprintf(out, "Include \"%s\"\n", index->files[0].path);
+        return 1;
+    }
+    if (ruleindex_write_file(index, index->files[0].path, keep, directives, out, 0) != 0) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        kept += (keep[i] == 1 && index->files[i].includes == 0) ? 1 : 0;
+    }
+    return kept;
+}
+
+// select the necessary files to run the tests of the given rules:
+// - every file which is not a CRS rule file (setup, initialization,
+//   blocking evaluation, ...)
+// - the files declaring the rules
+// - the files declaring the markers, which the kept rules skip to
+// returns an allocated array, 1 for every kept file
+int * ftw_ruleindex_keep_minimal(const ftw_ruleindex * index, const unsigned int * ids, unsigned int ids_count) {
+    int * keep    = calloc(index->files_count, sizeof(int));
+    int   changed = 1;
+
+    if (keep == NULL) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < index->files_count; i++) {
+        keep[i] = (index->files[i].includes == 0 && ftw_ruleindex_is_optional_file(index->files[i].path) == 0) ? 1 : 0;
+    }
+    for (unsigned int i = 0; i < ids_count; i++) {
+        const ftw_rule * rule = ftw_ruleindex_find(index, ids[i]);
+        if (rule == NULL) {
+            fprintf(stderr, "Warning: rule %u is not declared in the config\n", ids[i]);
+            continue;
+        }
+        keep[rule->file] = 1;
+    }
+    // the markers can be in other files
+    while (changed == 1) {
+        changed = 0;
+        for (unsigned int i = 0; i < index->files_count; i++) {
+            for (unsigned int t = 0; keep[i] == 1 && t < index->files[i].skip_targets_count; t++) {
+                int fi = ruleindex_find_marker(index, index->files[i].skip_targets[t]);
+                if (fi >= 0 && keep[fi] == 0) {
+                    keep[fi] = 1;
+                    changed  = 1;
+                }
+            }
+        }
+    }
+    return keep;
+}
+
+// find a rule by id
+// returns NULL if the rule is not declared in the config
+const ftw_rule * ftw_ruleindex_find(const ftw_ruleindex * index, unsigned int id) {
+    ftw_rule key;
+
+    if (index == NULL || index->rules_count == 0) {
+        return NULL;
+    }
+    key.id = id;
+    return bsearch(&key, index->rules, index->rules_count, sizeof(ftw_rule), ruleidcmp);
+}
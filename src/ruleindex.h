@@ -0,0 +1,71 @@
+/*
+ * This file is part of the ftwrunner distribution (https://github.com/digitalwave/ftwrunner).
+ * Copyright (c) 2022 digitalwave and Ervin Hegedüs.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//
+// ruleindex.h
+// structures and functions for indexing the rules of a WAF config
+//
+
+#ifndef _RULEINDEX_H
+#define _RULEINDEX_H
+
+#include <stdio.h>
+
+#define RULEINDEX_MAXDEPTH 32
+
+// the default phase of a rule if it has no 'phase' action
+#define RULEINDEX_DEFAULT_PHASE 2
+
+typedef struct ftw_rule_t {
+    unsigned int   id;
+    int            phase;
+    unsigned int   file;       // index in ftw_ruleindex.files
+    unsigned int   line_start; // the lines of the rule with its chain
+    unsigned int   line_end;
+} ftw_rule;
+
+typedef struct ftw_rulefile_t {
+    char          *path;
+    unsigned int   includes;   // number of 'Include' directives
+    char         **markers;    // declared SecMarkers
+    unsigned int   markers_count;
+    char         **skip_targets;
+    unsigned int   skip_targets_count;
+    char         **data_files; // the files of the operators of its rules, resolved
+    unsigned int   data_files_count;
+} ftw_rulefile;
+
+typedef struct ftw_ruleindex_t {
+    ftw_rulefile  *files;      // the config files in include order
+    unsigned int   files_count;
+    ftw_rule      *rules;      // sorted by id
+    unsigned int   rules_count;
+    char         **data_files; // the files of the operators (@pmFromFile...), resolved
+    unsigned int   data_files_count;
+} ftw_ruleindex;
+
+ftw_ruleindex  * ftw_ruleindex_new(const char * main_rule_uri);
+void             ftw_ruleindex_free(ftw_ruleindex * index);
+const ftw_rule * ftw_ruleindex_find(const ftw_ruleindex * index, unsigned int id);
+int              ftw_ruleindex_find_file(const ftw_ruleindex * index, const char * path);
+int              ftw_ruleindex_is_data_file(const ftw_ruleindex * index, const char * path);
+int              ftw_ruleindex_file_uses(const ftw_ruleindex * index, unsigned int file, const char * data_file);
+int              ftw_ruleindex_is_optional_file(const char * path);
+int            * ftw_ruleindex_keep_minimal(const ftw_ruleindex * index, const unsigned int * ids, unsigned int ids_count);
+int              ftw_ruleindex_write(const ftw_ruleindex * index, const int * keep, int directives, FILE * out);
+
+#endif